@@ -27,6 +27,8 @@
 // POSSIBILITY OF SUCH DAMAGE.
 
 #include <fp/all.hpp>
+#include <iterator>
+#include <vector>
 
 namespace views = ::ranges::views;
 
@@ -50,23 +52,19 @@ fp::Result<double> do_math(double x) {
   return fp::make_result(x).and_then(divide_4_by).and_then(safe_sqrt);
 }
 
-void print_errors(fp::Result<double> result) {
-  if (!result.has_value()) {
-    fmt::print("{}\n", result.error());
-  }
-}
-
 int main() {
   const auto x = views::iota(-5, 10) |
                  views::transform([](const int& x) { return x * 0.2; }) |
                  ranges::to<std::vector>();
-  const auto y =
-      x | views::transform(do_math) | views::filter([](const auto& result) {
-        print_errors(result);
-        return result.has_value();
-      }) |
-      views::transform([](const auto& result) { return result.value(); }) |
-      ranges::to<std::vector>();
+  auto y = std::vector<double>{};
+  auto errors = std::vector<fp::Error>{};
+  y.reserve(x.size());
+  fp::partition_results(x | views::transform(do_math), std::back_inserter(y),
+                        std::back_inserter(errors));
+
+  for (const auto& error : errors) {
+    fmt::print("{}\n", error);
+  }
 
   fmt::print("y = sqrt(4.0 / x)\nx = {}\ny = {}\n", x, y);
 
@@ -53,7 +53,7 @@ void validate_double() {
 int main() {
   validate_int_step();
   // 14 failed fp::validate_range with result: [Result<T>: [Error:
-  //   [OutOfRange] foo: 14 is 0.33333333333333304 away from the nearest valid
+  //   [OutOfRange] foo: 14 is 0.3333333333333333 away from the nearest valid
   //   step]]
 
   validate_double();
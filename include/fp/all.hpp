@@ -36,8 +36,27 @@
 #include <range/v3/all.hpp>
 
 #include "fp/_external/expected.hpp"
+#include "fp/backtrace.hpp"
+#include "fp/bulkhead.hpp"
+#include "fp/circuit_breaker.hpp"
+#include "fp/compact_optional.hpp"
+#include "fp/context.hpp"
+#include "fp/error_domain.hpp"
+#include "fp/error_map.hpp"
+#include "fp/expected_ref.hpp"
+#include "fp/instrumented.hpp"
+#include "fp/log.hpp"
 #include "fp/macros.hpp"
 #include "fp/monad.hpp"
 #include "fp/no_discard.hpp"
+#include "fp/parallel.hpp"
+#include "fp/pmr.hpp"
+#include "fp/rate_limit.hpp"
 #include "fp/result.hpp"
+#include "fp/serialize.hpp"
+#include "fp/stream.hpp"
+#include "fp/thread_pool.hpp"
+#include "fp/trace.hpp"
 #include "fp/validate.hpp"
+#include "fp/views.hpp"
+#include "fp/write_file.hpp"
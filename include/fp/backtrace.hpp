@@ -0,0 +1,227 @@
+// Copyright (c) 2022, Tyler Weaver
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <fmt/format.h>
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "fp/result.hpp"
+
+namespace fp {
+
+/**
+ * @brief      Raw return addresses of a call stack, symbolized only when
+ * formatted
+ */
+struct Backtrace {
+  static constexpr size_t kMaxFrames = 32;
+
+  std::array<void*, kMaxFrames> frames{};
+  size_t size = 0;
+};
+
+/**
+ * @brief      Capture the return addresses of the calling thread.  This
+ * unwinds the stack but does not symbolize it.
+ *
+ * @param[in]  skip  Number of frames to skip, the frame of this function is
+ * always skipped
+ *
+ * @return     The backtrace
+ */
+[[gnu::noinline]] inline std::shared_ptr<Backtrace const> capture_backtrace(
+    size_t skip = 0) {
+  auto raw = std::array<void*, Backtrace::kMaxFrames + 8>{};
+  auto const size = static_cast<size_t>(
+      ::backtrace(raw.data(), static_cast<int>(raw.size())));
+  auto backtrace = std::make_shared<Backtrace>();
+  for (size_t i = skip + 1; i < size && backtrace->size < Backtrace::kMaxFrames;
+       ++i) {
+    backtrace->frames[backtrace->size++] = raw[i];
+  }
+  return backtrace;
+}
+
+/**
+ * @brief      Decides which errors capture a backtrace.  Off by default, when
+ * enabled 1 in sample_every errors with a selected code captures one.  The
+ * check is two relaxed loads and a thread local counter.
+ */
+class BacktraceSampler {
+  std::atomic<uint32_t> sample_every_{0};
+  std::atomic<uint64_t> code_mask_{0};
+
+ public:
+  static BacktraceSampler& instance() {
+    static auto sampler = BacktraceSampler{};
+    return sampler;
+  }
+
+  /**
+   * @brief      Configure sampling
+   *
+   * @param[in]  sample_every  Capture 1 in sample_every errors, 0 disables
+   * capturing
+   * @param[in]  code_mask     Bit i set selects the error code with value i
+   */
+  void configure(uint32_t sample_every, uint64_t code_mask) noexcept {
+    code_mask_.store(code_mask, std::memory_order_relaxed);
+    sample_every_.store(sample_every, std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief      If an error with this code should capture a backtrace
+   *
+   * @param[in]  code  The value of the error code
+   */
+  bool sample(uint32_t code) noexcept {
+    auto const every = sample_every_.load(std::memory_order_relaxed);
+    if (every == 0 ||
+        (code_mask_.load(std::memory_order_relaxed) & (uint64_t{1} << code)) ==
+            0) {
+      return false;
+    }
+    thread_local uint32_t count = 0;
+    return ++count % every == 0;
+  }
+};
+
+/**
+ * @brief      Symbolize an address.  The result is cached so each address is
+ * only looked up once.
+ *
+ * @param[in]  address  The return address
+ *
+ * @return     The demangled symbol and offset or the module and offset if the
+ * symbol is not exported
+ */
+inline std::string const& symbolize(void* address) {
+  static auto mutex = std::mutex{};
+  static auto cache = std::unordered_map<void*, std::string>{};
+  auto const lock = std::lock_guard{mutex};
+  if (auto const it = cache.find(address); it != cache.end()) {
+    return it->second;
+  }
+
+  auto name = std::string{"??"};
+  auto info = Dl_info{};
+  if (dladdr(address, &info) != 0) {
+    if (info.dli_sname != nullptr) {
+      int status = 0;
+      auto const demangled = std::unique_ptr<char, decltype(&std::free)>{
+          abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status),
+          &std::free};
+      name = fmt::format(
+          "{}+{:#x}", status == 0 ? demangled.get() : info.dli_sname,
+          reinterpret_cast<uintptr_t>(address) -
+              reinterpret_cast<uintptr_t>(info.dli_saddr));
+    } else if (info.dli_fname != nullptr) {
+      name = fmt::format("{}+{:#x}", info.dli_fname,
+                         reinterpret_cast<uintptr_t>(address) -
+                             reinterpret_cast<uintptr_t>(info.dli_fbase));
+    }
+  }
+  return cache.emplace(address, std::move(name)).first->second;
+}
+
+/**
+ * @brief      Write a backtrace, one symbolized frame per line
+ *
+ * @param[in]  out        The output iterator
+ * @param[in]  backtrace  The backtrace
+ *
+ * @return     The output iterator
+ */
+template <typename OutputIt>
+OutputIt format_backtrace(OutputIt out, Backtrace const& backtrace) {
+  for (size_t i = 0; i < backtrace.size; ++i) {
+    out = fmt::format_to(out, "\n  #{} {} {}", i, backtrace.frames[i],
+                         symbolize(backtrace.frames[i]));
+  }
+  return out;
+}
+
+namespace detail {
+
+/**
+ * @brief      Capture a backtrace if the policy samples an error with this
+ * code.  Skips its own frame so the backtrace starts where the error was made.
+ */
+[[gnu::noinline]] inline std::shared_ptr<Backtrace const> sample_backtrace(
+    ErrorCode code) {
+  if (!BacktraceSampler::instance().sample(static_cast<uint32_t>(code))) {
+    return nullptr;
+  }
+  return capture_backtrace(1);
+}
+
+/**
+ * @brief      Format a backtrace for the {:b} error format
+ */
+inline std::string backtrace_to_string(Backtrace const& backtrace) {
+  auto buffer = fmt::memory_buffer{};
+  format_backtrace(std::back_inserter(buffer), backtrace);
+  return fmt::to_string(buffer);
+}
+
+}  // namespace detail
+
+/**
+ * @brief      Select which errors capture a backtrace.  Capturing is off by
+ * default.  The backtrace is symbolized when the error is formatted with {:b}.
+ *
+ * @param[in]  sample_every  Capture 1 in sample_every errors with one of the
+ * codes, 0 disables capturing
+ * @param[in]  codes         The error codes
+ */
+inline void set_backtrace_policy(
+    uint32_t sample_every,
+    std::initializer_list<ErrorCode> codes = {ErrorCode::INTERNAL,
+                                              ErrorCode::EXCEPTION}) {
+  BacktraceSampler::instance().configure(sample_every, error_code_mask(codes));
+  auto& hooks = detail::backtrace_hooks;
+  hooks.format.store(&detail::backtrace_to_string, std::memory_order_release);
+  hooks.sample.store(sample_every == 0 ? nullptr : &detail::sample_backtrace,
+                     std::memory_order_release);
+}
+
+}  // namespace fp
@@ -0,0 +1,185 @@
+// Copyright (c) 2022, Tyler Weaver
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <utility>
+
+#include "fp/result.hpp"
+
+namespace fp {
+
+/**
+ * @brief      Counts of a bulkhead
+ */
+struct BulkheadStats {
+  uint32_t in_flight;  ///< Calls running now
+  uint32_t waiting;    ///< Calls waiting for a slot now
+  uint64_t rejected;   ///< Calls that returned ResourceExhausted
+};
+
+namespace detail {
+
+/**
+ * @brief      Counting semaphore shared by the copies of a bulkhead.  Taking
+ * and releasing a slot is lock-free, only calls that wait for a slot use the
+ * mutex and condition variable.
+ */
+class BulkheadState {
+  uint32_t max_concurrent_;
+  uint32_t queue_limit_;
+  std::atomic<uint32_t> in_flight_{0};
+  std::atomic<uint32_t> waiting_{0};
+  std::atomic<uint64_t> rejected_{0};
+  std::mutex mutex_;
+  std::condition_variable cv_;
+
+  static uint32_t checked_max_concurrent(uint32_t max_concurrent) {
+    if (max_concurrent == 0) {
+      throw std::invalid_argument("bulkhead max_concurrent must be positive");
+    }
+    return max_concurrent;
+  }
+
+  bool try_acquire() {
+    auto in_flight = in_flight_.load();
+    while (in_flight < max_concurrent_) {
+      if (in_flight_.compare_exchange_weak(in_flight, in_flight + 1)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+ public:
+  BulkheadState(uint32_t max_concurrent, uint32_t queue_limit)
+      : max_concurrent_(checked_max_concurrent(max_concurrent)),
+        queue_limit_(queue_limit) {}
+
+  /**
+   * @brief      Take a slot, waiting for one if the wait list has room
+   *
+   * @return     False if the call is rejected
+   */
+  bool acquire() {
+    if (try_acquire()) return true;
+    if (waiting_.fetch_add(1) >= queue_limit_) {
+      waiting_.fetch_sub(1);
+      rejected_.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+    {
+      auto lock = std::unique_lock{mutex_};
+      cv_.wait(lock, [this] { return try_acquire(); });
+    }
+    waiting_.fetch_sub(1);
+    return true;
+  }
+
+  void release() {
+    in_flight_.fetch_sub(1);
+    if (waiting_.load() > 0) {
+      { auto const lock = std::lock_guard{mutex_}; }
+      cv_.notify_one();
+    }
+  }
+
+  BulkheadStats stats() const {
+    return {in_flight_.load(std::memory_order_relaxed),
+            waiting_.load(std::memory_order_relaxed),
+            rejected_.load(std::memory_order_relaxed)};
+  }
+};
+
+/**
+ * @brief      Releases a slot when the call returns or throws
+ */
+struct BulkheadSlot {
+  BulkheadState* state;
+
+  explicit BulkheadSlot(BulkheadState* state) : state(state) {}
+  BulkheadSlot(BulkheadSlot const&) = delete;
+  BulkheadSlot& operator=(BulkheadSlot const&) = delete;
+  ~BulkheadSlot() { state->release(); }
+};
+
+}  // namespace detail
+
+/**
+ * @brief      Function wrapped by a bulkhead.  Copies share the bulkhead.
+ *
+ * @tparam     F     The function type, returning a Result
+ */
+template <typename F>
+struct Bulkhead {
+  std::shared_ptr<detail::BulkheadState> bulkhead;
+  F f;
+
+  template <typename... Args>
+  auto operator()(Args&&... args) const
+      -> decltype(f(std::forward<Args>(args)...)) {
+    if (!bulkhead->acquire()) {
+      return tl::make_unexpected(
+          ResourceExhausted("bulkhead concurrency limit reached"));
+    }
+    auto const slot = detail::BulkheadSlot{bulkhead.get()};
+    return f(std::forward<Args>(args)...);
+  }
+
+  BulkheadStats stats() const { return bulkhead->stats(); }
+};
+
+/**
+ * @brief      Wrap a function returning a Result so no more than
+ * max_concurrent calls run at once.  Further calls wait for a slot while
+ * fewer than queue_limit are waiting, otherwise they return ResourceExhausted
+ * without calling f.
+ *
+ * @param[in]  f               The function
+ * @param[in]  max_concurrent  Calls allowed to run at once, throws
+ * std::invalid_argument if it is 0
+ * @param[in]  queue_limit     Calls allowed to wait, 0 to fail fast
+ *
+ * @tparam     F               The function type
+ *
+ * @return     The wrapped function, usable as a stage with operator|
+ */
+template <typename F>
+Bulkhead<F> bulkhead(F f, uint32_t max_concurrent, uint32_t queue_limit = 0) {
+  return Bulkhead<F>{
+      std::make_shared<detail::BulkheadState>(max_concurrent, queue_limit),
+      std::move(f)};
+}
+
+}  // namespace fp
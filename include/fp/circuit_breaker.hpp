@@ -0,0 +1,302 @@
+// Copyright (c) 2022, Tyler Weaver
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <utility>
+
+#include "fp/result.hpp"
+
+namespace fp {
+
+/**
+ * @brief      State of a circuit breaker
+ */
+enum class CircuitState : int {
+  CLOSED,     ///< Calls pass through and failures are counted
+  OPEN,       ///< Calls fail immediately until the cooldown has passed
+  HALF_OPEN,  ///< A limited number of probe calls decide to close or reopen
+};
+
+/**
+ * @brief      Options for circuit_breaker
+ */
+struct CircuitBreakerPolicy {
+  /// Open when at least this ratio of the calls in a window fail
+  double failure_ratio = 0.5;
+  /// Calls in a window before the ratio is checked
+  uint32_t minimum_calls = 20;
+  /// The counts are reset at the start of each window
+  std::chrono::nanoseconds window = std::chrono::seconds{10};
+  /// Time the breaker stays open before probing
+  std::chrono::nanoseconds cooldown = std::chrono::seconds{5};
+  /// Probe calls allowed at once while half open
+  uint32_t half_open_probes = 1;
+  /// Errors that count as failures of the dependency, others count as
+  /// successful calls
+  uint64_t failure_codes =
+      error_code_mask({ErrorCode::UNAVAILABLE, ErrorCode::TIMEOUT});
+};
+
+/**
+ * @brief      Counts of a circuit breaker
+ */
+struct CircuitBreakerStats {
+  CircuitState state;
+  uint32_t window_calls;     ///< Calls in the current window
+  uint32_t window_failures;  ///< Failures in the current window
+  uint64_t rejected;         ///< Calls rejected without calling the function
+};
+
+namespace detail {
+
+/**
+ * @brief      State shared by the copies of a circuit breaker.  The calls and
+ * failures of the window are packed in one word so they are updated together
+ * without a lock.  The open time is written only by the call that opened the
+ * breaker and is kNotOpen otherwise, so a call that sees OPEN before the time
+ * is written is rejected.
+ */
+template <typename Clock>
+class CircuitBreakerState {
+  CircuitBreakerPolicy policy_;
+  Clock clock_;
+  std::atomic<int> state_{static_cast<int>(CircuitState::CLOSED)};
+  std::atomic<int64_t> opened_at_{kNotOpen};
+  std::atomic<int64_t> window_start_;
+  std::atomic<uint64_t> counts_{0};  ///< calls << 32 | failures
+  std::atomic<uint32_t> probes_{0};
+  std::atomic<uint64_t> rejected_{0};
+
+  static constexpr uint64_t kCall = uint64_t{1} << 32;
+  static constexpr int64_t kNotOpen = std::numeric_limits<int64_t>::max();
+
+ public:
+  CircuitBreakerState(CircuitBreakerPolicy policy, Clock clock)
+      : policy_(std::move(policy)),
+        clock_(std::move(clock)),
+        window_start_(now()) {}
+
+  int64_t now() const {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               clock_.now().time_since_epoch())
+        .count();
+  }
+
+  CircuitState state() const {
+    return static_cast<CircuitState>(state_.load(std::memory_order_acquire));
+  }
+
+  bool is_failure(ErrorCode code) const {
+    return in_error_code_mask(policy_.failure_codes, code);
+  }
+
+  /**
+   * @brief      Decide if a call may run
+   *
+   * @param[out] probe  Set if the call is a half open probe
+   *
+   * @return     False if the call is rejected
+   */
+  bool acquire(bool& probe) {
+    auto state = this->state();
+    if (state == CircuitState::OPEN) {
+      auto opened_at = opened_at_.load(std::memory_order_acquire);
+      if (opened_at == kNotOpen ||
+          now() - opened_at < policy_.cooldown.count()) {
+        rejected_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+      }
+      auto expected = static_cast<int>(CircuitState::OPEN);
+      if (state_.compare_exchange_strong(
+              expected, static_cast<int>(CircuitState::HALF_OPEN),
+              std::memory_order_acq_rel)) {
+        // unless a failed probe already reopened it
+        opened_at_.compare_exchange_strong(opened_at, kNotOpen,
+                                           std::memory_order_acq_rel);
+      }
+      state = this->state();
+    }
+    if (state == CircuitState::HALF_OPEN) {
+      if (probes_.fetch_add(1, std::memory_order_acq_rel) >=
+          policy_.half_open_probes) {
+        probes_.fetch_sub(1, std::memory_order_relaxed);
+        rejected_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+      }
+      probe = true;
+    }
+    return true;
+  }
+
+  void record_probe(bool failed) {
+    if (failed) {
+      open();
+    } else {
+      reset_window(now());
+      opened_at_.store(kNotOpen, std::memory_order_relaxed);
+      state_.store(static_cast<int>(CircuitState::CLOSED),
+                   std::memory_order_release);
+    }
+    probes_.fetch_sub(1, std::memory_order_acq_rel);
+  }
+
+  void record(bool failed) {
+    auto const time = now();
+    auto start = window_start_.load(std::memory_order_relaxed);
+    if (time - start >= policy_.window.count() &&
+        window_start_.compare_exchange_strong(start, time,
+                                              std::memory_order_relaxed)) {
+      counts_.store(0, std::memory_order_relaxed);
+    }
+    auto const counts = counts_.fetch_add(kCall + (failed ? 1 : 0),
+                                          std::memory_order_relaxed) +
+                        kCall + (failed ? 1 : 0);
+    auto const calls = static_cast<uint32_t>(counts >> 32);
+    auto const failures = static_cast<uint32_t>(counts);
+    if (failed && calls >= policy_.minimum_calls &&
+        failures >= policy_.failure_ratio * calls) {
+      auto expected = static_cast<int>(CircuitState::CLOSED);
+      if (state_.compare_exchange_strong(expected,
+                                         static_cast<int>(CircuitState::OPEN),
+                                         std::memory_order_acq_rel)) {
+        opened_at_.store(time, std::memory_order_release);
+      }
+    }
+  }
+
+  CircuitBreakerStats stats() const {
+    auto const counts = counts_.load(std::memory_order_relaxed);
+    return {state(), static_cast<uint32_t>(counts >> 32),
+            static_cast<uint32_t>(counts),
+            rejected_.load(std::memory_order_relaxed)};
+  }
+
+ private:
+  void open() {
+    auto expected = static_cast<int>(CircuitState::HALF_OPEN);
+    if (state_.compare_exchange_strong(expected,
+                                       static_cast<int>(CircuitState::OPEN),
+                                       std::memory_order_acq_rel)) {
+      opened_at_.store(now(), std::memory_order_release);
+    }
+  }
+
+  void reset_window(int64_t time) {
+    window_start_.store(time, std::memory_order_relaxed);
+    counts_.store(0, std::memory_order_relaxed);
+  }
+};
+
+/**
+ * @brief      Records the outcome of a half open probe when the call returns
+ * or throws, so the probe slot is always released.  A probe that throws counts
+ * as failed.
+ */
+template <typename Clock>
+struct CircuitBreakerProbe {
+  CircuitBreakerState<Clock>* state;
+  bool failed = true;
+
+  explicit CircuitBreakerProbe(CircuitBreakerState<Clock>* state)
+      : state(state) {}
+  CircuitBreakerProbe(CircuitBreakerProbe const&) = delete;
+  CircuitBreakerProbe& operator=(CircuitBreakerProbe const&) = delete;
+  ~CircuitBreakerProbe() {
+    if (state != nullptr) state->record_probe(failed);
+  }
+};
+
+}  // namespace detail
+
+/**
+ * @brief      Function wrapped by a circuit breaker.  Copies share the
+ * breaker.
+ *
+ * @tparam     F      The function type, returning a Result
+ * @tparam     Clock  Provides now(), std::chrono::steady_clock by default
+ */
+template <typename F, typename Clock = std::chrono::steady_clock>
+struct CircuitBreaker {
+  std::shared_ptr<detail::CircuitBreakerState<Clock>> breaker;
+  F f;
+
+  template <typename... Args>
+  auto operator()(Args&&... args) const
+      -> decltype(f(std::forward<Args>(args)...)) {
+    auto probe = false;
+    if (!breaker->acquire(probe)) {
+      return tl::make_unexpected(Unavailable("circuit breaker is open"));
+    }
+    auto guard = detail::CircuitBreakerProbe<Clock>{probe ? breaker.get()
+                                                         : nullptr};
+    auto ret = f(std::forward<Args>(args)...);
+    auto const failed = !ret && breaker->is_failure(ret.error().code);
+    if (probe) {
+      guard.failed = failed;
+    } else {
+      breaker->record(failed);
+    }
+    return ret;
+  }
+
+  CircuitState state() const { return breaker->state(); }
+  CircuitBreakerStats stats() const { return breaker->stats(); }
+};
+
+/**
+ * @brief      Wrap a function returning a Result so that once too many of its
+ * recent calls fail with one of the failure codes, calls fail immediately with
+ * Unavailable for a cooldown.  After the cooldown a probe call is let through,
+ * if it succeeds the breaker closes and if it fails it opens again.
+ *
+ * @param[in]  f       The function, for example calling a dependency
+ * @param[in]  policy  The thresholds and timings
+ * @param[in]  clock   The clock, injectable for testing
+ *
+ * @tparam     F       The function type
+ * @tparam     Clock   The clock type
+ *
+ * @return     The wrapped function, usable as a stage with operator|
+ */
+template <typename F, typename Clock = std::chrono::steady_clock>
+CircuitBreaker<F, Clock> circuit_breaker(F f,
+                                         CircuitBreakerPolicy policy = {},
+                                         Clock clock = {}) {
+  return CircuitBreaker<F, Clock>{
+      std::make_shared<detail::CircuitBreakerState<Clock>>(std::move(policy),
+                                                           std::move(clock)),
+      std::move(f)};
+}
+
+}  // namespace fp
@@ -0,0 +1,142 @@
+// Copyright (c) 2022, Tyler Weaver
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <limits>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+namespace fp {
+
+/**
+ * @brief      Sentinel for compact_optional using NaN as the empty state
+ *
+ * @tparam     T     A floating point type
+ */
+template <typename T>
+struct nan_sentinel {
+  static_assert(std::is_floating_point_v<T>,
+                "nan_sentinel requires a floating point type");
+
+  static constexpr T empty_value() noexcept {
+    return std::numeric_limits<T>::quiet_NaN();
+  }
+  static constexpr bool is_empty(T const& value) noexcept {
+    return value != value;
+  }
+};
+
+/**
+ * @brief      Sentinel for compact_optional using a reserved value as the
+ * empty state, for example -1 for indices
+ *
+ * @tparam     T      The value type
+ * @tparam     Value  The reserved value
+ */
+template <typename T, T Value>
+struct value_sentinel {
+  static constexpr T empty_value() noexcept { return Value; }
+  static constexpr bool is_empty(T const& value) noexcept {
+    return value == Value;
+  }
+};
+
+/**
+ * @brief      Optional that stores the empty state as a sentinel value of T,
+ * so it is the same size as T and a vector of them stays dense.  Storing the
+ * sentinel value makes it empty.
+ *
+ * @tparam     T         The value type
+ * @tparam     Sentinel  Provides static empty_value() and is_empty(T const&)
+ */
+template <typename T, typename Sentinel>
+class compact_optional {
+  T value_ = Sentinel::empty_value();
+
+ public:
+  using value_type = T;
+
+  constexpr compact_optional() noexcept = default;
+  constexpr compact_optional(std::nullopt_t) noexcept {}
+  constexpr compact_optional(T value) noexcept(
+      std::is_nothrow_move_constructible_v<T>)
+      : value_(std::move(value)) {}
+  constexpr compact_optional(std::optional<T> const& opt)
+      : value_(opt ? *opt : Sentinel::empty_value()) {}
+
+  constexpr bool has_value() const noexcept {
+    return !Sentinel::is_empty(value_);
+  }
+  constexpr explicit operator bool() const noexcept { return has_value(); }
+
+  constexpr T& value() & {
+    if (!has_value()) throw std::bad_optional_access();
+    return value_;
+  }
+  constexpr T const& value() const& {
+    if (!has_value()) throw std::bad_optional_access();
+    return value_;
+  }
+  constexpr T&& value() && {
+    if (!has_value()) throw std::bad_optional_access();
+    return std::move(value_);
+  }
+
+  constexpr T& operator*() & noexcept { return value_; }
+  constexpr T const& operator*() const& noexcept { return value_; }
+  constexpr T&& operator*() && noexcept { return std::move(value_); }
+  constexpr T* operator->() noexcept { return &value_; }
+  constexpr T const* operator->() const noexcept { return &value_; }
+
+  template <typename U>
+  constexpr T value_or(U&& default_value) const& {
+    return has_value() ? value_
+                       : static_cast<T>(std::forward<U>(default_value));
+  }
+
+  constexpr void reset() noexcept { value_ = Sentinel::empty_value(); }
+
+  /**
+   * @brief      Convert to std::optional<T>
+   */
+  constexpr std::optional<T> to_optional() const {
+    return has_value() ? std::optional<T>{value_} : std::nullopt;
+  }
+
+  constexpr bool operator==(compact_optional const& other) const {
+    if (has_value() != other.has_value()) return false;
+    return !has_value() || value_ == other.value_;
+  }
+  constexpr bool operator!=(compact_optional const& other) const {
+    return !(*this == other);
+  }
+};
+
+}  // namespace fp
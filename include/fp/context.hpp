@@ -0,0 +1,429 @@
+// Copyright (c) 2022, Tyler Weaver
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#pragma once
+
+#include <fmt/args.h>
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#if __cplusplus > 201703L && __has_include(<source_location>)
+#include <source_location>
+#ifdef __cpp_lib_source_location
+#define FP_HAS_STD_SOURCE_LOCATION
+#endif
+#endif
+
+namespace fp {
+
+/**
+ * @brief      Location in the source code.  With C++20 this is a
+ * std::source_location, a single pointer to static data.  With C++17 it is
+ * built from compiler builtins and holds pointers to string literals and the
+ * line.  Either way capturing one does no formatting.
+ */
+class SourceLocation {
+#ifdef FP_HAS_STD_SOURCE_LOCATION
+  std::source_location location_;
+
+ public:
+  constexpr SourceLocation() noexcept = default;
+  constexpr explicit SourceLocation(std::source_location location) noexcept
+      : location_(location) {}
+
+  static constexpr SourceLocation current(
+      std::source_location location =
+          std::source_location::current()) noexcept {
+    return SourceLocation{location};
+  }
+
+  constexpr char const* file() const noexcept { return location_.file_name(); }
+  constexpr char const* function() const noexcept {
+    return location_.function_name();
+  }
+  constexpr uint32_t line() const noexcept { return location_.line(); }
+#else
+  char const* file_ = "";
+  char const* function_ = "";
+  uint32_t line_ = 0;
+
+ public:
+  constexpr SourceLocation() noexcept = default;
+  constexpr SourceLocation(char const* file, char const* function,
+                           uint32_t line) noexcept
+      : file_(file), function_(function), line_(line) {}
+
+  static constexpr SourceLocation current(
+      char const* file = __builtin_FILE(),
+      char const* function = __builtin_FUNCTION(),
+      uint32_t line = __builtin_LINE()) noexcept {
+    return SourceLocation{file, function, line};
+  }
+
+  constexpr char const* file() const noexcept { return file_; }
+  constexpr char const* function() const noexcept { return function_; }
+  constexpr uint32_t line() const noexcept { return line_; }
+#endif
+
+  /**
+   * @brief      If this is a captured location rather than the default
+   */
+  constexpr bool empty() const noexcept { return line() == 0; }
+};
+
+/**
+ * @brief      A context message and where it was added.  Implicitly
+ * constructed from a string literal so the location is captured at the call
+ * site.
+ */
+struct ContextMessage {
+  char const* message;
+  SourceLocation location;
+
+  constexpr ContextMessage(
+      char const* message,
+      SourceLocation location = SourceLocation::current()) noexcept
+      : message(message), location(location) {}
+};
+
+/**
+ * @brief      An argument of a context message, stored inline in the frame
+ */
+struct ContextArg {
+  enum class Type : uint8_t { INT, UINT, DOUBLE, BOOL, CHAR, STRING };
+
+  Type type = Type::INT;
+  union {
+    int64_t i;
+    uint64_t u;
+    double d;
+    bool b;
+    char c;
+    struct {
+      uint16_t offset;
+      uint16_t size;
+    } s;
+  };
+};
+
+/**
+ * @brief      One frame of context added to an Error.  Frames are immutable
+ * once linked and shared between copies of an Error through a reference
+ * count.
+ */
+struct ContextFrame {
+  static constexpr size_t kMaxArgs = 4;
+  static constexpr size_t kTextSize = 48;
+
+  std::atomic<uint32_t> refs{0};
+  uint8_t arg_count = 0;
+  uint8_t text_size = 0;
+  ContextFrame* next = nullptr;
+  char const* message = "";
+  SourceLocation location;
+  std::array<ContextArg, kMaxArgs> args;
+  std::array<char, kTextSize> text;
+
+  /**
+   * @brief      Store an argument inline.  Strings are copied into the text
+   * buffer of the frame and truncated if it is full.
+   */
+  template <typename T>
+  void push_arg(T const& value) noexcept {
+    auto& arg = args[arg_count++];
+    if constexpr (std::is_same_v<T, bool>) {
+      arg.type = ContextArg::Type::BOOL;
+      arg.b = value;
+    } else if constexpr (std::is_same_v<T, char>) {
+      arg.type = ContextArg::Type::CHAR;
+      arg.c = value;
+    } else if constexpr (std::is_integral_v<T> && std::is_signed_v<T>) {
+      arg.type = ContextArg::Type::INT;
+      arg.i = value;
+    } else if constexpr (std::is_integral_v<T>) {
+      arg.type = ContextArg::Type::UINT;
+      arg.u = value;
+    } else if constexpr (std::is_floating_point_v<T>) {
+      arg.type = ContextArg::Type::DOUBLE;
+      arg.d = value;
+    } else {
+      static_assert(std::is_convertible_v<T const&, std::string_view>,
+                    "context arguments must be arithmetic or strings");
+      auto const view = std::string_view{value};
+      auto const size = std::min(view.size(), kTextSize - text_size);
+      std::memcpy(text.data() + text_size, view.data(), size);
+      arg.type = ContextArg::Type::STRING;
+      arg.s = {text_size, static_cast<uint16_t>(size)};
+      text_size += static_cast<uint8_t>(size);
+    }
+  }
+};
+
+/**
+ * @brief      Pool of ContextFrames.  Each thread takes frames from its own
+ * free list so adding context does not lock or allocate once the pool is
+ * warm.  Frames are allocated in blocks that are never freed, frames released
+ * on a thread go to the free list of that thread.  A free list that grows
+ * past kMaxFree, as on a thread that destroys errors created on another
+ * thread, hands a block's worth of frames to the shared list, and the free
+ * list of a thread that exits is handed to the shared list as well.
+ */
+class ContextPool {
+  static constexpr size_t kBlockSize = 64;
+  static constexpr size_t kMaxFree = 2 * kBlockSize;
+
+  struct Shared {
+    std::mutex mutex;
+    ContextFrame* free = nullptr;
+    std::vector<std::unique_ptr<ContextFrame[]>> blocks;
+  };
+
+  static Shared& shared() {
+    // leaked so frames outlive the destruction of static objects
+    static auto* const shared = new Shared{};
+    return *shared;
+  }
+
+  ContextFrame* free_ = nullptr;
+  size_t free_count_ = 0;
+
+  ContextPool() = default;
+
+ public:
+  ContextPool(ContextPool const&) = delete;
+  ContextPool& operator=(ContextPool const&) = delete;
+
+  ~ContextPool() {
+    if (free_ == nullptr) return;
+    auto* last = free_;
+    while (last->next != nullptr) last = last->next;
+    auto& global = shared();
+    auto const lock = std::lock_guard{global.mutex};
+    last->next = global.free;
+    global.free = free_;
+  }
+
+  /**
+   * @brief      The pool of the calling thread
+   */
+  static ContextPool& local() {
+    thread_local ContextPool pool;
+    return pool;
+  }
+
+  /**
+   * @brief      Number of frames allocated by all threads
+   */
+  static size_t allocated() {
+    auto& global = shared();
+    auto const lock = std::lock_guard{global.mutex};
+    return global.blocks.size() * kBlockSize;
+  }
+
+  /**
+   * @brief      Take a frame with a reference count of one
+   */
+  ContextFrame* acquire() {
+    if (free_ == nullptr) refill();
+    auto* frame = free_;
+    free_ = frame->next;
+    --free_count_;
+    frame->refs.store(1, std::memory_order_relaxed);
+    frame->arg_count = 0;
+    frame->text_size = 0;
+    frame->next = nullptr;
+    return frame;
+  }
+
+  /**
+   * @brief      Drop a reference to a chain of frames, returning the frames
+   * that are no longer referenced to the pool
+   */
+  void release(ContextFrame* frame) noexcept {
+    while (frame != nullptr &&
+           frame->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      auto* next = frame->next;
+      frame->next = free_;
+      free_ = frame;
+      frame = next;
+      if (++free_count_ > kMaxFree) spill();
+    }
+  }
+
+ private:
+  /// Move kBlockSize frames from the front of the free list to the shared list
+  void spill() noexcept {
+    auto* last = free_;
+    for (size_t i = 1; i < kBlockSize; ++i) last = last->next;
+    auto* const rest = last->next;
+    auto& global = shared();
+    {
+      auto const lock = std::lock_guard{global.mutex};
+      last->next = global.free;
+      global.free = free_;
+    }
+    free_ = rest;
+    free_count_ -= kBlockSize;
+  }
+
+  /// Take up to kBlockSize frames from the shared list or allocate a block
+  void refill() {
+    auto& global = shared();
+    auto const lock = std::lock_guard{global.mutex};
+    if (global.free != nullptr) {
+      auto* last = global.free;
+      free_count_ = 1;
+      while (free_count_ < kBlockSize && last->next != nullptr) {
+        last = last->next;
+        ++free_count_;
+      }
+      free_ = global.free;
+      global.free = last->next;
+      last->next = nullptr;
+      return;
+    }
+    auto& block = global.blocks.emplace_back(
+        std::make_unique<ContextFrame[]>(kBlockSize));
+    for (size_t i = 0; i < kBlockSize; ++i) {
+      block[i].next = free_;
+      free_ = &block[i];
+    }
+    free_count_ = kBlockSize;
+  }
+};
+
+/**
+ * @brief      Chain of context frames of an Error, most recent first.  Copies
+ * share the frames.
+ */
+class ContextChain {
+  ContextFrame* head_ = nullptr;
+
+ public:
+  ContextChain() = default;
+  ContextChain(ContextChain const& other) noexcept : head_(other.head_) {
+    if (head_ != nullptr) head_->refs.fetch_add(1, std::memory_order_relaxed);
+  }
+  ContextChain(ContextChain&& other) noexcept : head_(other.head_) {
+    other.head_ = nullptr;
+  }
+  ContextChain& operator=(ContextChain other) noexcept {
+    std::swap(head_, other.head_);
+    return *this;
+  }
+  ~ContextChain() {
+    if (head_ != nullptr) ContextPool::local().release(head_);
+  }
+
+  bool empty() const noexcept { return head_ == nullptr; }
+  ContextFrame const* head() const noexcept { return head_; }
+
+  /**
+   * @brief      Add a frame from ContextPool::acquire to the front of the
+   * chain, taking ownership of it
+   */
+  void push(ContextFrame* frame) noexcept {
+    frame->next = head_;
+    head_ = frame;
+  }
+};
+
+/**
+ * @brief      Write " at file:line" for a location if it is not empty
+ *
+ * @param[in]  out       The output iterator
+ * @param[in]  location  The location
+ *
+ * @return     The output iterator
+ */
+template <typename OutputIt>
+OutputIt format_location(OutputIt out, SourceLocation const& location) {
+  if (location.empty()) return out;
+  return fmt::format_to(out, " at {}:{}", location.file(), location.line());
+}
+
+/**
+ * @brief      Write a context frame, formatting its message with its arguments
+ *
+ * @param[in]  out            The output iterator
+ * @param[in]  frame          The frame
+ * @param[in]  with_location  If the source location should be written
+ *
+ * @return     The output iterator
+ */
+template <typename OutputIt>
+OutputIt format_frame(OutputIt out, ContextFrame const& frame,
+                      bool with_location) {
+  auto store = fmt::dynamic_format_arg_store<fmt::format_context>{};
+  for (size_t i = 0; i < frame.arg_count; ++i) {
+    auto const& arg = frame.args[i];
+    switch (arg.type) {
+      case ContextArg::Type::INT:
+        store.push_back(arg.i);
+        break;
+      case ContextArg::Type::UINT:
+        store.push_back(arg.u);
+        break;
+      case ContextArg::Type::DOUBLE:
+        store.push_back(arg.d);
+        break;
+      case ContextArg::Type::BOOL:
+        store.push_back(arg.b);
+        break;
+      case ContextArg::Type::CHAR:
+        store.push_back(arg.c);
+        break;
+      case ContextArg::Type::STRING:
+        store.push_back(std::string_view{frame.text.data() + arg.s.offset,
+                                         arg.s.size});
+        break;
+    }
+  }
+  try {
+    out = fmt::vformat_to(out, frame.message, store);
+  } catch (fmt::format_error const&) {
+    out = fmt::format_to(out, "{}", frame.message);
+  }
+  if (with_location) {
+    out = format_location(out, frame.location);
+  }
+  return out;
+}
+
+}  // namespace fp
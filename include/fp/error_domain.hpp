@@ -0,0 +1,177 @@
+// Copyright (c) 2022, Tyler Weaver
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+#include <type_traits>
+
+#include "fp/result_fwd.hpp"
+
+namespace fp {
+
+/**
+ * @brief      Specialize for an enum to make it an error domain, a set of
+ * codes more specific than ErrorCode.  The specialization has
+ *
+ *     static constexpr std::string_view name;       // unique, e.g. "ik"
+ *     static constexpr ErrorCode canonical(Enum);   // the generic code
+ *     static constexpr std::string_view to_string(Enum);
+ *
+ * The domain ID is a hash of name computed at compile time.
+ *
+ * @tparam     Enum  The enum of the domain's codes, its values fit in 32 bits
+ */
+template <typename Enum>
+struct ErrorDomain {};
+
+namespace detail {
+
+template <typename Enum, typename = void>
+struct IsErrorDomain : std::false_type {};
+template <typename Enum>
+struct IsErrorDomain<Enum, std::void_t<decltype(ErrorDomain<Enum>::name)>>
+    : std::is_enum<Enum> {};
+
+constexpr uint32_t domain_id(std::string_view name) {
+  uint32_t hash = 2166136261U;
+  for (auto const c : name) {
+    hash = (hash ^ static_cast<uint8_t>(c)) * 16777619U;
+  }
+  return hash == 0 ? 1 : hash;
+}
+
+}  // namespace detail
+
+/**
+ * @brief      True if Enum has an ErrorDomain specialization
+ */
+template <typename Enum>
+constexpr bool is_error_domain_v = detail::IsErrorDomain<Enum>::value;
+
+/**
+ * @brief      Static description of a domain, one per domain enum
+ */
+struct DomainInfo {
+  uint32_t id;
+  std::string_view name;
+  std::string_view (*to_string)(uint32_t value);
+  ErrorCode (*canonical)(uint32_t value);
+};
+
+namespace detail {
+
+template <typename Enum>
+struct DomainThunks {
+  static std::string_view to_string(uint32_t value) {
+    return ErrorDomain<Enum>::to_string(static_cast<Enum>(value));
+  }
+  static ErrorCode canonical(uint32_t value) {
+    return ErrorDomain<Enum>::canonical(static_cast<Enum>(value));
+  }
+};
+
+}  // namespace detail
+
+/**
+ * @brief      The DomainInfo of Enum
+ */
+template <typename Enum>
+inline constexpr DomainInfo domain_info = {
+    detail::domain_id(ErrorDomain<Enum>::name), ErrorDomain<Enum>::name,
+    &detail::DomainThunks<Enum>::to_string,
+    &detail::DomainThunks<Enum>::canonical};
+
+/**
+ * @brief      A code from an error domain, or none.  Trivially copyable, and
+ * compared by a single integer holding the domain ID and the value.
+ */
+struct DomainCode {
+  uint64_t bits = 0;                  ///< domain id << 32 | value, 0 if none
+  DomainInfo const* info = nullptr;  ///< for formatting, null if none
+
+  constexpr explicit operator bool() const noexcept { return bits != 0; }
+  constexpr uint32_t domain() const noexcept {
+    return static_cast<uint32_t>(bits >> 32);
+  }
+  constexpr uint32_t value() const noexcept {
+    return static_cast<uint32_t>(bits);
+  }
+
+  constexpr bool operator==(DomainCode const& other) const noexcept {
+    return bits == other.bits;
+  }
+  constexpr bool operator!=(DomainCode const& other) const noexcept {
+    return bits != other.bits;
+  }
+};
+
+static_assert(std::is_trivially_copyable_v<DomainCode>);
+
+/**
+ * @brief      Make the DomainCode of a code from an error domain
+ *
+ * @param[in]  code  The code
+ *
+ * @tparam     Enum  The domain enum
+ *
+ * @return     The domain code
+ */
+template <typename Enum,
+          typename = std::enable_if_t<is_error_domain_v<Enum>>>
+constexpr DomainCode domain_code(Enum code) noexcept {
+  return DomainCode{
+      (uint64_t{domain_info<Enum>.id} << 32) | static_cast<uint32_t>(code),
+      &domain_info<Enum>};
+}
+
+/**
+ * @brief      Compare a DomainCode with a code from an error domain
+ */
+template <typename Enum,
+          typename = std::enable_if_t<is_error_domain_v<Enum>>>
+constexpr bool operator==(DomainCode const& lhs, Enum rhs) noexcept {
+  return lhs.bits == domain_code(rhs).bits;
+}
+template <typename Enum,
+          typename = std::enable_if_t<is_error_domain_v<Enum>>>
+constexpr bool operator!=(DomainCode const& lhs, Enum rhs) noexcept {
+  return lhs.bits != domain_code(rhs).bits;
+}
+
+/**
+ * @brief      True if code is from the error domain Enum
+ */
+template <typename Enum>
+constexpr bool in_domain(DomainCode const& code) noexcept {
+  return code.domain() == domain_info<Enum>.id;
+}
+
+}  // namespace fp
@@ -0,0 +1,235 @@
+// Copyright (c) 2022, Tyler Weaver
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "fp/result.hpp"
+
+namespace fp {
+
+/**
+ * @brief      An Error with its hash computed once when it is made.  The error
+ * can only be read, so the hash cannot go stale, and equality compares the
+ * hashes before the messages.  Use it as the key of an ErrorMap or a standard
+ * hash container to hash each message once instead of on every lookup.
+ */
+class HashedError {
+  Error error_;
+  uint64_t hash_;
+
+ public:
+  /// Implicit so an Error can be passed where a HashedError is expected
+  HashedError(Error error)
+      : error_(std::move(error)), hash_(std::hash<Error>{}(error_)) {}
+
+  Error const& error() const noexcept { return error_; }
+  uint64_t hash() const noexcept { return hash_; }
+
+  bool operator==(HashedError const& other) const noexcept {
+    return hash_ == other.hash_ && error_ == other.error_;
+  }
+  bool operator!=(HashedError const& other) const noexcept {
+    return !(*this == other);
+  }
+};
+
+/**
+ * @brief      Flat open addressing map from errors to values, for counting and
+ * grouping errors.  The hash of an error is computed once per insert or
+ * lookup and stored in its slot with the index of its entry, so probing and
+ * growing read no messages and a message is only compared when the hashes
+ * match.  With HashedError keys the hash is not computed again on lookup.
+ * Entries are stored contiguously in insertion order and are never erased,
+ * clear() removes all of them.
+ *
+ * @tparam     V     The value type
+ * @tparam     E     The error type
+ */
+template <typename V, typename E = Error>
+class ErrorMap {
+  struct Slot {
+    uint64_t hash = 0;  ///< 0 if empty
+    uint32_t index = 0;
+  };
+
+  std::vector<Slot> slots_;
+  std::vector<std::pair<E, V>> entries_;
+
+ public:
+  using value_type = std::pair<E, V>;
+  using iterator = typename std::vector<value_type>::iterator;
+  using const_iterator = typename std::vector<value_type>::const_iterator;
+
+  ErrorMap() = default;
+
+  /**
+   * @brief      Make a map with room for capacity errors before it grows
+   *
+   * @param[in]  capacity  The number of errors
+   */
+  explicit ErrorMap(size_t capacity) { reserve(capacity); }
+
+  iterator begin() noexcept { return entries_.begin(); }
+  iterator end() noexcept { return entries_.end(); }
+  const_iterator begin() const noexcept { return entries_.begin(); }
+  const_iterator end() const noexcept { return entries_.end(); }
+  size_t size() const noexcept { return entries_.size(); }
+  bool empty() const noexcept { return entries_.empty(); }
+
+  /**
+   * @brief      Make room for capacity errors, keeping the load at most 1/2
+   *
+   * @param[in]  capacity  The number of errors
+   */
+  void reserve(size_t capacity) {
+    entries_.reserve(capacity);
+    size_t slots = 16;
+    while (slots < capacity * 2) slots *= 2;
+    if (slots > slots_.size()) grow(slots);
+  }
+
+  /**
+   * @brief      Remove all errors, keeping the capacity
+   */
+  void clear() noexcept {
+    entries_.clear();
+    std::fill(slots_.begin(), slots_.end(), Slot{});
+  }
+
+  /**
+   * @brief      Find an error
+   *
+   * @param[in]  error  The error
+   *
+   * @return     Iterator to its entry, or end() if it is not in the map
+   */
+  iterator find(E const& error) { return begin() + find_index(error); }
+  const_iterator find(E const& error) const {
+    return begin() + find_index(error);
+  }
+
+  /**
+   * @brief      Number of entries equal to error, 0 or 1
+   */
+  size_t count(E const& error) const { return find(error) == end() ? 0 : 1; }
+
+  /**
+   * @brief      Insert error with a value made from args if it is not in the
+   * map
+   *
+   * @param[in]  error  The error
+   * @param[in]  args   The arguments to construct the value from
+   *
+   * @return     Iterator to the entry and true if it was inserted
+   */
+  template <typename... Args>
+  std::pair<iterator, bool> try_emplace(E const& error, Args&&... args) {
+    return emplace(error, std::forward<Args>(args)...);
+  }
+  template <typename... Args>
+  std::pair<iterator, bool> try_emplace(E&& error, Args&&... args) {
+    return emplace(std::move(error), std::forward<Args>(args)...);
+  }
+
+  /**
+   * @brief      The value of error, inserting a value initialized one if it is
+   * not in the map
+   */
+  V& operator[](E const& error) { return try_emplace(error).first->second; }
+  V& operator[](E&& error) {
+    return try_emplace(std::move(error)).first->second;
+  }
+
+ private:
+  size_t mask() const noexcept { return slots_.size() - 1; }
+
+  /// The index of the entry of error, or size() if it is not in the map
+  size_t find_index(E const& error) const {
+    if (slots_.empty()) return size();
+    auto const hash = slot_hash(error);
+    for (auto i = hash & mask();; i = (i + 1) & mask()) {
+      auto const& slot = slots_[i];
+      if (slot.hash == 0) return size();
+      if (slot.hash == hash && entries_[slot.index].first == error) {
+        return slot.index;
+      }
+    }
+  }
+
+  static uint64_t slot_hash(E const& error) noexcept {
+    auto const hash = static_cast<uint64_t>(std::hash<E>{}(error));
+    return hash == 0 ? 1 : hash;
+  }
+
+  template <typename Key, typename... Args>
+  std::pair<iterator, bool> emplace(Key&& error, Args&&... args) {
+    if ((entries_.size() + 1) * 2 > slots_.size()) {
+      grow(slots_.empty() ? 16 : slots_.size() * 2);
+    }
+    auto const hash = slot_hash(error);
+    auto i = hash & mask();
+    for (; slots_[i].hash != 0; i = (i + 1) & mask()) {
+      auto const& slot = slots_[i];
+      if (slot.hash == hash && entries_[slot.index].first == error) {
+        return {begin() + slot.index, false};
+      }
+    }
+    entries_.emplace_back(std::piecewise_construct,
+                          std::forward_as_tuple(std::forward<Key>(error)),
+                          std::forward_as_tuple(std::forward<Args>(args)...));
+    slots_[i] = Slot{hash, static_cast<uint32_t>(entries_.size() - 1)};
+    return {end() - 1, true};
+  }
+
+  void grow(size_t size) {
+    auto old = std::exchange(slots_, std::vector<Slot>(size));
+    for (auto const& slot : old) {
+      if (slot.hash == 0) continue;
+      auto i = slot.hash & mask();
+      while (slots_[i].hash != 0) i = (i + 1) & mask();
+      slots_[i] = slot;
+    }
+  }
+};
+
+}  // namespace fp
+
+template <>
+struct std::hash<fp::HashedError> {
+  size_t operator()(fp::HashedError const& error) const noexcept {
+    return static_cast<size_t>(error.hash());
+  }
+};
@@ -0,0 +1,126 @@
+// Copyright (c) 2022, Tyler Weaver
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#pragma once
+
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+#include "fp/_external/expected.hpp"
+
+namespace tl {
+
+/**
+ * @brief      Specialization of tl::expected for references.  Stores a pointer
+ * to the referenced object so a Result<T&> can borrow a value (for example an
+ * element of a container) without copying it.  Like a pointer, constness of
+ * the expected does not propagate to the referenced value.
+ *
+ * @tparam     T     The referenced type
+ * @tparam     E     The error type
+ */
+template <class T, class E>
+class expected<T&, E> {
+  expected<T*, E> impl_;
+
+ public:
+  typedef T& value_type;
+  typedef E error_type;
+  typedef unexpected<E> unexpected_type;
+
+  constexpr expected(T& value) noexcept : impl_(std::addressof(value)) {}
+  expected(T&& value) = delete;
+
+  template <class U, detail::enable_if_t<std::is_convertible<U*, T*>::value>* =
+                         nullptr>
+  constexpr expected(const expected<U&, E>& other)
+      : impl_(other.has_value() ? expected<T*, E>(std::addressof(*other))
+                                : expected<T*, E>(unexpect, other.error())) {}
+
+  template <class G, detail::enable_if_t<
+                         std::is_constructible<E, const G&>::value>* = nullptr>
+  constexpr expected(const unexpected<G>& e) : impl_(e) {}
+
+  template <class G,
+            detail::enable_if_t<std::is_constructible<E, G&&>::value>* =
+                nullptr>
+  constexpr expected(unexpected<G>&& e) : impl_(std::move(e)) {}
+
+  template <class... Args>
+  constexpr explicit expected(unexpect_t, Args&&... args)
+      : impl_(unexpect, std::forward<Args>(args)...) {}
+
+  constexpr bool has_value() const noexcept { return impl_.has_value(); }
+  constexpr explicit operator bool() const noexcept { return has_value(); }
+
+  constexpr T& value() const { return *impl_.value(); }
+  constexpr T& operator*() const { return **impl_; }
+  constexpr T* operator->() const { return *impl_; }
+
+  constexpr const E& error() const& { return impl_.error(); }
+  TL_EXPECTED_11_CONSTEXPR E& error() & { return impl_.error(); }
+  TL_EXPECTED_11_CONSTEXPR E&& error() && { return std::move(impl_).error(); }
+
+  template <class U>
+  constexpr T& value_or(U& default_value) const {
+    return has_value() ? **impl_ : default_value;
+  }
+
+  template <class F>
+  constexpr auto and_then(F&& f) const& {
+    using Ret = detail::decay_t<detail::invoke_result_t<F, T&>>;
+    return has_value() ? detail::invoke(std::forward<F>(f), **impl_)
+                       : Ret(unexpect, error());
+  }
+  template <class F>
+  TL_EXPECTED_11_CONSTEXPR auto and_then(F&& f) && {
+    using Ret = detail::decay_t<detail::invoke_result_t<F, T&>>;
+    return has_value() ? detail::invoke(std::forward<F>(f), **impl_)
+                       : Ret(unexpect, std::move(impl_).error());
+  }
+
+  template <class F>
+  constexpr auto map(F&& f) const {
+    return impl_.map([&f](T* value) -> decltype(auto) {
+      return detail::invoke(std::forward<F>(f), *value);
+    });
+  }
+
+  template <class F>
+  constexpr auto map_error(F&& f) const {
+    using G = detail::decay_t<detail::invoke_result_t<F, const E&>>;
+    return has_value() ? expected<T&, G>(**impl_)
+                       : expected<T&, G>(unexpect, detail::invoke(
+                                                       std::forward<F>(f),
+                                                       error()));
+  }
+};
+
+}  // namespace tl
@@ -0,0 +1,446 @@
+// Copyright (c) 2022, Tyler Weaver
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#pragma once
+
+#include <fmt/format.h>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "fp/result.hpp"
+#include "fp/write_file.hpp"
+
+namespace fp {
+
+/**
+ * @brief      Number of ErrorCode values, used to count errors by code
+ */
+constexpr size_t kErrorCodeCount =
+    static_cast<size_t>(ErrorCode::EXCEPTION) + 1;
+
+/**
+ * @brief      If R has an error() with an ErrorCode code like Result<T>
+ */
+template <typename R, typename = void>
+constexpr bool has_error_code_v = false;
+template <typename R>
+constexpr bool has_error_code_v<
+    R, std::void_t<decltype(std::declval<R const&>().error().code)>> =
+    std::is_same_v<
+        std::decay_t<decltype(std::declval<R const&>().error().code)>,
+        ErrorCode>;
+
+/**
+ * @brief      Log-linear bucketing of latencies in nanoseconds like
+ * HdrHistogram.  Values below 16 get their own bucket, above that each power of
+ * two is split into 16 linear buckets giving a relative error below 6.25%.
+ * Values of 2^40ns (about 18 minutes) or more go in the last bucket.
+ */
+struct LatencyBuckets {
+  static constexpr int kSubBucketBits = 4;
+  static constexpr uint64_t kSubBuckets = uint64_t{1} << kSubBucketBits;
+  static constexpr int kMaxBits = 40;
+  static constexpr size_t kCount =
+      kSubBuckets + (kMaxBits - kSubBucketBits) * kSubBuckets;
+
+  static constexpr size_t index(uint64_t value) noexcept {
+    if (value < kSubBuckets) return static_cast<size_t>(value);
+    if (value >= (uint64_t{1} << kMaxBits)) return kCount - 1;
+    auto const exponent = 63 - __builtin_clzll(value);
+    auto const group = exponent - kSubBucketBits;
+    auto const sub = (value >> group) & (kSubBuckets - 1);
+    return static_cast<size_t>(kSubBuckets + group * kSubBuckets + sub);
+  }
+
+  static constexpr uint64_t lower_bound(size_t index) noexcept {
+    if (index < kSubBuckets) return index;
+    auto const group = (index - kSubBuckets) / kSubBuckets;
+    auto const sub = (index - kSubBuckets) % kSubBuckets;
+    return (kSubBuckets + sub) << group;
+  }
+
+  static constexpr uint64_t upper_bound(size_t index) noexcept {
+    if (index < kSubBuckets) return index;
+    auto const group = (index - kSubBuckets) / kSubBuckets;
+    return lower_bound(index) + (uint64_t{1} << group) - 1;
+  }
+};
+
+/**
+ * @brief      Merged, non-atomic copy of one or more latency histograms
+ */
+struct HistogramSnapshot {
+  std::array<uint64_t, LatencyBuckets::kCount> buckets{};
+  uint64_t count = 0;
+  uint64_t sum_ns = 0;
+
+  /**
+   * @brief      The latency at a quantile
+   *
+   * @param[in]  q     The quantile in [0, 1]
+   *
+   * @return     Upper bound of the bucket containing the quantile in
+   * nanoseconds, 0 if there are no values
+   */
+  uint64_t quantile(double q) const noexcept {
+    if (count == 0) return 0;
+    auto const rank = static_cast<uint64_t>(q * static_cast<double>(count));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < buckets.size(); ++i) {
+      seen += buckets[i];
+      if (seen > rank) return LatencyBuckets::upper_bound(i);
+    }
+    return LatencyBuckets::upper_bound(buckets.size() - 1);
+  }
+};
+
+/**
+ * @brief      Latency histogram with wait-free recording
+ */
+class LatencyHistogram {
+  std::array<std::atomic<uint64_t>, LatencyBuckets::kCount> buckets_{};
+  std::atomic<uint64_t> count_{0};
+  std::atomic<uint64_t> sum_ns_{0};
+
+ public:
+  void record(uint64_t ns) noexcept {
+    buckets_[LatencyBuckets::index(ns)].fetch_add(1,
+                                                  std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+    sum_ns_.fetch_add(ns, std::memory_order_relaxed);
+  }
+
+  void merge_into(HistogramSnapshot& snapshot) const noexcept {
+    for (size_t i = 0; i < buckets_.size(); ++i) {
+      snapshot.buckets[i] += buckets_[i].load(std::memory_order_relaxed);
+    }
+    snapshot.count += count_.load(std::memory_order_relaxed);
+    snapshot.sum_ns += sum_ns_.load(std::memory_order_relaxed);
+  }
+};
+
+/**
+ * @brief      Merged latency statistics of a named pipeline
+ */
+struct PipelineStats {
+  std::string name;
+  HistogramSnapshot success;
+  HistogramSnapshot error;
+  std::array<uint64_t, kErrorCodeCount> error_codes{};
+};
+
+/**
+ * @brief      Latency histograms of a named pipeline.  Each thread records into
+ * one of kShards cache line aligned shards so recording is a few uncontended
+ * relaxed increments.
+ */
+class PipelineMetrics {
+ public:
+  static constexpr size_t kShards = 16;
+
+ private:
+  struct alignas(64) Shard {
+    LatencyHistogram success;
+    LatencyHistogram error;
+    std::array<std::atomic<uint64_t>, kErrorCodeCount> error_codes{};
+  };
+
+  std::string name_;
+  std::unique_ptr<Shard[]> shards_ = std::make_unique<Shard[]>(kShards);
+
+  static size_t shard_index() noexcept {
+    static std::atomic<size_t> next{0};
+    thread_local size_t const index =
+        next.fetch_add(1, std::memory_order_relaxed) % kShards;
+    return index;
+  }
+
+ public:
+  explicit PipelineMetrics(std::string name) : name_(std::move(name)) {}
+
+  std::string const& name() const noexcept { return name_; }
+
+  void record_success(uint64_t ns) noexcept {
+    shards_[shard_index()].success.record(ns);
+  }
+
+  void record_error(uint64_t ns) noexcept {
+    shards_[shard_index()].error.record(ns);
+  }
+
+  void record_error(uint64_t ns, ErrorCode code) noexcept {
+    auto& shard = shards_[shard_index()];
+    shard.error.record(ns);
+    shard.error_codes[static_cast<size_t>(code)].fetch_add(
+        1, std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief      Merge the shards of all threads
+   */
+  PipelineStats stats() const {
+    auto stats = PipelineStats{name_, {}, {}, {}};
+    for (size_t i = 0; i < kShards; ++i) {
+      shards_[i].success.merge_into(stats.success);
+      shards_[i].error.merge_into(stats.error);
+      for (size_t code = 0; code < kErrorCodeCount; ++code) {
+        stats.error_codes[code] +=
+            shards_[i].error_codes[code].load(std::memory_order_relaxed);
+      }
+    }
+    return stats;
+  }
+};
+
+/**
+ * @brief      Registry of the metrics of all named pipelines.  The mutex is
+ * only taken when creating an instrumented pipeline and when reporting.
+ */
+class MetricsRegistry {
+  std::mutex mutex_;
+  std::map<std::string, std::shared_ptr<PipelineMetrics>> metrics_;
+
+ public:
+  static MetricsRegistry& instance() {
+    static auto registry = MetricsRegistry{};
+    return registry;
+  }
+
+  /**
+   * @brief      Get the metrics for a name, creating them if needed.
+   * Pipelines instrumented with the same name share their metrics.
+   */
+  std::shared_ptr<PipelineMetrics> get(std::string const& name) {
+    auto const lock = std::lock_guard{mutex_};
+    auto& metrics = metrics_[name];
+    if (!metrics) metrics = std::make_shared<PipelineMetrics>(name);
+    return metrics;
+  }
+
+  std::vector<PipelineStats> stats() {
+    auto const lock = std::lock_guard{mutex_};
+    auto stats = std::vector<PipelineStats>{};
+    stats.reserve(metrics_.size());
+    for (auto const& [name, metrics] : metrics_) {
+      stats.push_back(metrics->stats());
+    }
+    return stats;
+  }
+};
+
+/**
+ * @brief      A pipeline that records the latency of each call
+ *
+ * @tparam     F     The pipeline type
+ */
+template <typename F>
+struct Instrumented {
+  std::shared_ptr<PipelineMetrics> metrics;
+  F f;
+
+  template <typename... Args>
+  auto operator()(Args&&... args) const
+      -> decltype(f(std::forward<Args>(args)...)) {
+    auto const begin = std::chrono::steady_clock::now();
+    auto ret = f(std::forward<Args>(args)...);
+    auto const ns = static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - begin)
+            .count());
+    if (ret) {
+      metrics->record_success(ns);
+    } else if constexpr (has_error_code_v<decltype(ret)>) {
+      metrics->record_error(ns, ret.error().code);
+    } else {
+      metrics->record_error(ns);
+    }
+    return ret;
+  }
+};
+
+/**
+ * @brief      Wrap a pipeline, for example one built with mcompose, so the
+ * latency of each call is recorded in a histogram under name.  Calls that
+ * return an error are recorded separately and counted by ErrorCode.
+ *
+ * @param[in]  name      The name of the pipeline
+ * @param[in]  pipeline  The pipeline
+ *
+ * @tparam     F         The pipeline type
+ *
+ * @return     The instrumented pipeline
+ */
+template <typename F>
+Instrumented<F> instrumented(std::string const& name, F pipeline) {
+  return Instrumented<F>{MetricsRegistry::instance().get(name), pipeline};
+}
+
+/**
+ * @brief      Merged statistics of all instrumented pipelines
+ */
+inline std::vector<PipelineStats> pipeline_stats() {
+  return MetricsRegistry::instance().stats();
+}
+
+/**
+ * @brief      Format pipeline statistics as human readable text
+ *
+ * @param[in]  stats  The statistics
+ *
+ * @return     One line per pipeline and outcome with count and p50/p99/p999
+ * latencies, followed by the error counts by code
+ */
+inline std::string format_stats_text(std::vector<PipelineStats> const& stats) {
+  auto out = fmt::memory_buffer{};
+  auto const histogram = [&out](std::string const& name,
+                                std::string_view outcome,
+                                HistogramSnapshot const& snapshot) {
+    fmt::format_to(std::back_inserter(out),
+                   "{} {}: count={} p50={}ns p99={}ns p999={}ns\n", name,
+                   outcome, snapshot.count, snapshot.quantile(0.5),
+                   snapshot.quantile(0.99), snapshot.quantile(0.999));
+  };
+  for (auto const& pipeline : stats) {
+    histogram(pipeline.name, "success", pipeline.success);
+    histogram(pipeline.name, "error", pipeline.error);
+    for (size_t code = 0; code < kErrorCodeCount; ++code) {
+      if (pipeline.error_codes[code] == 0) continue;
+      fmt::format_to(std::back_inserter(out), "{} error {}: count={}\n",
+                     pipeline.name,
+                     toStringView(static_cast<ErrorCode>(code)),
+                     pipeline.error_codes[code]);
+    }
+  }
+  return fmt::to_string(out);
+}
+
+namespace detail {
+
+/**
+ * @brief      Escape a label value of the Prometheus text format, where
+ * backslash, double quote and line feed must be written as \\, \" and \n
+ */
+inline std::string escape_label_value(std::string_view in) {
+  auto out = std::string{};
+  out.reserve(in.size());
+  for (auto const c : in) {
+    if (c == '\\' || c == '"') {
+      out.push_back('\\');
+      out.push_back(c);
+    } else if (c == '\n') {
+      out += "\\n";
+    } else {
+      out.push_back(c);
+    }
+  }
+  return out;
+}
+
+}  // namespace detail
+
+/**
+ * @brief      Format pipeline statistics in the Prometheus text exposition
+ * format, latencies as a summary in seconds and errors as a counter by code
+ *
+ * @param[in]  stats  The statistics
+ *
+ * @return     The exposition text
+ */
+inline std::string format_stats_prometheus(
+    std::vector<PipelineStats> const& stats) {
+  auto out = fmt::memory_buffer{};
+  auto it = std::back_inserter(out);
+  fmt::format_to(it, "# TYPE fp_pipeline_latency_seconds summary\n");
+  for (auto const& pipeline : stats) {
+    auto const name = detail::escape_label_value(pipeline.name);
+    for (auto const& [outcome, snapshot] :
+         {std::pair{"success", &pipeline.success},
+          std::pair{"error", &pipeline.error}}) {
+      auto const labels =
+          fmt::format("pipeline=\"{}\",outcome=\"{}\"", name, outcome);
+      for (auto const q : {0.5, 0.99, 0.999}) {
+        fmt::format_to(
+            it, "fp_pipeline_latency_seconds{{{},quantile=\"{}\"}} {}\n",
+            labels, q, static_cast<double>(snapshot->quantile(q)) / 1e9);
+      }
+      fmt::format_to(it, "fp_pipeline_latency_seconds_sum{{{}}} {}\n", labels,
+                     static_cast<double>(snapshot->sum_ns) / 1e9);
+      fmt::format_to(it, "fp_pipeline_latency_seconds_count{{{}}} {}\n", labels,
+                     snapshot->count);
+    }
+  }
+  fmt::format_to(it, "# TYPE fp_pipeline_errors_total counter\n");
+  for (auto const& pipeline : stats) {
+    auto const name = detail::escape_label_value(pipeline.name);
+    for (size_t code = 0; code < kErrorCodeCount; ++code) {
+      fmt::format_to(
+          it, "fp_pipeline_errors_total{{pipeline=\"{}\",code=\"{}\"}} {}\n",
+          name, toStringView(static_cast<ErrorCode>(code)),
+          pipeline.error_codes[code]);
+    }
+  }
+  return fmt::to_string(out);
+}
+
+/**
+ * @brief      Format of the statistics written by write_pipeline_stats
+ */
+enum class StatsFormat { TEXT, PROMETHEUS };
+
+/**
+ * @brief      Merge the statistics of all instrumented pipelines and write
+ * them to a file
+ *
+ * @param[in]  path    The file to write
+ * @param[in]  format  The format
+ *
+ * @return     Unavailable error if the file could not be written
+ */
+inline Result<void> write_pipeline_stats(std::string const& path,
+                                         StatsFormat format) {
+  auto const stats = pipeline_stats();
+  auto const text = format == StatsFormat::PROMETHEUS
+                        ? format_stats_prometheus(stats)
+                        : format_stats_text(stats);
+  return detail::write_file(path, text, "stats");
+}
+
+}  // namespace fp
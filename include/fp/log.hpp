@@ -0,0 +1,488 @@
+// Copyright (c) 2022, Tyler Weaver
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+
+#include "fp/result.hpp"
+
+#ifndef FP_LOG_TABLE_SIZE
+#define FP_LOG_TABLE_SIZE 1024
+#endif
+
+#ifndef FP_LOG_QUEUE_SIZE
+#define FP_LOG_QUEUE_SIZE 1024
+#endif
+
+#ifndef FP_LOG_MESSAGE_SIZE
+#define FP_LOG_MESSAGE_SIZE 256
+#endif
+
+namespace fp {
+
+/**
+ * @brief      Options for log_error
+ */
+struct LogPolicy {
+  /// Lines written per key in each window, the rest are counted, at most
+  /// 2^24 - 1
+  uint32_t lines_per_window = 10;
+  std::chrono::nanoseconds window = std::chrono::seconds{1};
+};
+
+/**
+ * @brief      Counts of log_error
+ */
+struct LogStats {
+  uint64_t emitted;     ///< Errors queued to be written
+  uint64_t suppressed;  ///< Errors over the limit of their key
+  uint64_t dropped;     ///< Errors lost because the queue was full
+};
+
+namespace detail {
+
+inline uint64_t fnv1a(uint64_t hash, void const* data, size_t size) {
+  auto const* bytes = static_cast<unsigned char const*>(data);
+  for (size_t i = 0; i < size; ++i) {
+    hash = (hash ^ bytes[i]) * 1099511628211ULL;
+  }
+  return hash;
+}
+
+inline uint64_t fnv1a(uint64_t hash, SourceLocation const& location) {
+  auto const* const file = location.file();
+  auto const line = location.line();
+  hash = fnv1a(hash, &file, sizeof(file));
+  return fnv1a(hash, &line, sizeof(line));
+}
+
+/**
+ * @brief      Key errors are deduplicated by, the code and domain code, where
+ * the error was logged and where it was created or the message if that
+ * location is unknown.  Errors made at one site inside the library and logged
+ * from different call sites have different keys.  Never 0.
+ */
+inline uint64_t log_key(Error const& error, SourceLocation const& site) {
+  auto hash = fnv1a(14695981039346656037ULL, &error.code, sizeof(error.code));
+  hash = fnv1a(hash, &error.domain.bits, sizeof(error.domain.bits));
+  hash = fnv1a(hash, site);
+  if (!error.location.empty()) {
+    hash = fnv1a(hash, error.location);
+  } else {
+    hash = fnv1a(hash, error.what.data(), error.what.size());
+  }
+  return hash | 1U;
+}
+
+/**
+ * @brief      Throttling state of one key.  The window number and the lines
+ * written in it are packed in one word so a new window and its first line are
+ * counted together.
+ */
+struct alignas(64) LogSlot {
+  static constexpr int kLineBits = 24;
+  static constexpr uint64_t kLineMask = (uint64_t{1} << kLineBits) - 1;
+
+  std::atomic<uint64_t> key{0};
+  std::atomic<uint64_t> window_lines{0};  ///< window << kLineBits | lines
+  std::atomic<uint64_t> suppressed{0};
+
+  static constexpr uint64_t packed(uint64_t window) {
+    return window & (~uint64_t{0} >> kLineBits);
+  }
+
+  /// True if no line has been counted in window, so the key can be replaced
+  bool expired(uint64_t window) const {
+    return (window_lines.load(std::memory_order_relaxed) >> kLineBits) !=
+           packed(window);
+  }
+
+  /**
+   * @brief      Count a line in window if there are fewer than limit
+   *
+   * @return     False if the line is over the limit
+   */
+  bool try_count(uint64_t window, uint64_t limit) {
+    auto current = window_lines.load(std::memory_order_relaxed);
+    while (true) {
+      auto desired = (window << kLineBits) | 1U;
+      if ((current >> kLineBits) == packed(window)) {
+        if ((current & kLineMask) >= limit) return false;
+        desired = current + 1;
+      }
+      if (window_lines.compare_exchange_weak(current, desired,
+                                             std::memory_order_relaxed)) {
+        return true;
+      }
+    }
+  }
+};
+
+/**
+ * @brief      An error waiting to be written.  The message is copied into a
+ * fixed buffer, truncated to FP_LOG_MESSAGE_SIZE, and the context frames are
+ * shared so queueing an error does not allocate.
+ */
+struct LogEntry {
+  ErrorCode code = ErrorCode::UNKNOWN;
+  DomainCode domain = {};
+  ContextChain context = {};
+  uint64_t suppressed = 0;
+  size_t what_size = 0;  ///< Size of the message before truncation
+  std::array<char, FP_LOG_MESSAGE_SIZE> what;
+
+  LogEntry() = default;
+  LogEntry(Error const& error, uint64_t suppressed)
+      : code(error.code),
+        domain(error.domain),
+        context(error.context),
+        suppressed(suppressed),
+        what_size(error.what.size()) {
+    std::copy_n(error.what.data(), std::min(what_size, what.size()),
+                what.data());
+  }
+
+  /// The error to format, without its location and backtrace
+  Error to_error() const {
+    auto error = Error{};
+    error.code = code;
+    error.what.assign(what.data(), std::min(what_size, what.size()));
+    if (what_size > what.size()) error.what += "...";
+    error.context = context;
+    error.domain = domain;
+    return error;
+  }
+};
+
+/**
+ * @brief      Bounded multi producer queue, each cell has a sequence number
+ * so producers claim cells with one compare and swap
+ */
+template <typename T, size_t Capacity>
+class LogQueue {
+  static_assert((Capacity & (Capacity - 1)) == 0,
+                "capacity must be a power of two");
+
+  struct Cell {
+    std::atomic<size_t> sequence;
+    T value;
+  };
+
+  std::array<Cell, Capacity> cells_;
+  alignas(64) std::atomic<size_t> head_{0};
+  alignas(64) std::atomic<size_t> tail_{0};
+
+ public:
+  LogQueue() {
+    for (size_t i = 0; i < Capacity; ++i) {
+      cells_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  bool push(T value) {
+    auto position = tail_.load(std::memory_order_relaxed);
+    while (true) {
+      auto& cell = cells_[position & (Capacity - 1)];
+      auto const sequence = cell.sequence.load(std::memory_order_acquire);
+      auto const diff = static_cast<std::ptrdiff_t>(sequence) -
+                        static_cast<std::ptrdiff_t>(position);
+      if (diff == 0) {
+        if (tail_.compare_exchange_weak(position, position + 1,
+                                        std::memory_order_relaxed)) {
+          cell.value = std::move(value);
+          cell.sequence.store(position + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (diff < 0) {
+        return false;
+      } else {
+        position = tail_.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  /// Single consumer
+  bool pop(T& value) {
+    auto const position = head_.load(std::memory_order_relaxed);
+    auto& cell = cells_[position & (Capacity - 1)];
+    if (cell.sequence.load(std::memory_order_acquire) != position + 1) {
+      return false;
+    }
+    value = std::move(cell.value);
+    cell.sequence.store(position + Capacity, std::memory_order_release);
+    head_.store(position + 1, std::memory_order_relaxed);
+    return true;
+  }
+};
+
+}  // namespace detail
+
+/**
+ * @brief      Deduplicating, throttled writer of errors.  The calling thread
+ * only hashes the error and updates the counters of its key, errors under the
+ * limit are copied without allocating to a queue and formatted and written by
+ * a background thread, which sleeps while the queue is empty.
+ */
+class ErrorLogger {
+  using Sink = std::function<void(std::string_view)>;
+
+  std::array<detail::LogSlot, FP_LOG_TABLE_SIZE + 1> table_;
+  detail::LogQueue<detail::LogEntry, FP_LOG_QUEUE_SIZE> queue_;
+  std::atomic<uint32_t> lines_per_window_{10};
+  std::atomic<int64_t> window_{1'000'000'000};
+  std::atomic<uint64_t> emitted_{0};
+  std::atomic<uint64_t> suppressed_{0};
+  std::atomic<uint64_t> dropped_{0};
+  std::atomic<uint64_t> written_{0};
+  std::atomic<uint64_t> pending_{0};  ///< Entries pushed but not yet written
+  std::mutex wake_mutex_;
+  std::condition_variable wake_;
+  std::mutex sink_mutex_;
+  Sink sink_ = [](std::string_view line) {
+    std::fwrite(line.data(), 1, line.size(), stderr);
+    std::fputc('\n', stderr);
+  };
+  std::atomic<bool> stop_{false};
+  std::thread writer_;
+
+  static constexpr size_t kMaxProbes = 16;
+
+  ErrorLogger() : writer_([this] { run(); }) {}
+
+  static int64_t now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+  }
+
+  /**
+   * @brief      The slot of key.  If the probed slots are taken the first one
+   * whose key has not logged in window is given to key, dropping the
+   * suppressed count it had not written yet.  The last slot is shared by keys
+   * that do not fit.
+   */
+  detail::LogSlot& slot(uint64_t key, uint64_t window) {
+    detail::LogSlot* stale = nullptr;
+    auto stale_key = uint64_t{0};
+    for (size_t probe = 0; probe < kMaxProbes; ++probe) {
+      auto& slot = table_[(key + probe) % FP_LOG_TABLE_SIZE];
+      auto existing = slot.key.load(std::memory_order_acquire);
+      if (existing == key) return slot;
+      if (existing == 0 && slot.key.compare_exchange_strong(existing, key)) {
+        return slot;
+      }
+      if (existing == key) return slot;
+      if (stale == nullptr && existing != 0 && slot.expired(window)) {
+        stale = &slot;
+        stale_key = existing;
+      }
+    }
+    if (stale != nullptr) {
+      if (stale->key.compare_exchange_strong(stale_key, key)) {
+        stale->suppressed.store(0, std::memory_order_relaxed);
+        return *stale;
+      }
+      if (stale_key == key) return *stale;
+    }
+    return table_[FP_LOG_TABLE_SIZE];
+  }
+
+  void write(detail::LogEntry const& entry) {
+    auto line = fmt::format("{}", entry.to_error());
+    if (entry.suppressed > 0) {
+      line += fmt::format(" ({} similar errors suppressed)", entry.suppressed);
+    }
+    auto const lock = std::lock_guard{sink_mutex_};
+    sink_(line);
+  }
+
+  /// Sleeps while the queue is empty, woken by the push that makes it
+  /// non-empty
+  void run() {
+    auto entry = detail::LogEntry{};
+    while (true) {
+      if (queue_.pop(entry)) {
+        write(entry);
+        written_.fetch_add(1, std::memory_order_release);
+        pending_.fetch_sub(1, std::memory_order_acq_rel);
+        continue;
+      }
+      if (pending_.load(std::memory_order_acquire) > 0) {
+        // claimed by a producer that has not finished writing the cell
+        std::this_thread::yield();
+        continue;
+      }
+      auto lock = std::unique_lock{wake_mutex_};
+      wake_.wait(lock, [this] {
+        return pending_.load(std::memory_order_acquire) > 0 ||
+               stop_.load(std::memory_order_acquire);
+      });
+      if (pending_.load(std::memory_order_acquire) == 0) return;
+    }
+  }
+
+  /// Only the push that makes the queue non-empty takes the lock to wake the
+  /// writer
+  bool push(detail::LogEntry entry) {
+    auto const was_empty =
+        pending_.fetch_add(1, std::memory_order_acq_rel) == 0;
+    auto const pushed = queue_.push(std::move(entry));
+    if (!pushed) pending_.fetch_sub(1, std::memory_order_acq_rel);
+    if (was_empty) {
+      auto const lock = std::lock_guard{wake_mutex_};
+      wake_.notify_one();
+    }
+    return pushed;
+  }
+
+ public:
+  ErrorLogger(ErrorLogger const&) = delete;
+  ErrorLogger& operator=(ErrorLogger const&) = delete;
+  ~ErrorLogger() {
+    {
+      auto const lock = std::lock_guard{wake_mutex_};
+      stop_.store(true, std::memory_order_release);
+    }
+    wake_.notify_one();
+    writer_.join();
+  }
+
+  static ErrorLogger& instance() {
+    static ErrorLogger logger;
+    return logger;
+  }
+
+  void configure(LogPolicy const& policy) {
+    lines_per_window_.store(policy.lines_per_window,
+                            std::memory_order_relaxed);
+    window_.store(policy.window.count(), std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief      Set where lines are written, stderr by default.  Called from
+   * the background thread.
+   */
+  void set_sink(Sink sink) {
+    auto const lock = std::lock_guard{sink_mutex_};
+    sink_ = std::move(sink);
+  }
+
+  void log(Error const& error,
+           SourceLocation site = SourceLocation::current()) {
+    auto const window = static_cast<uint64_t>(
+        now() / std::max<int64_t>(window_.load(std::memory_order_relaxed), 1));
+    auto& slot = this->slot(detail::log_key(error, site), window);
+    if (!slot.try_count(window,
+                        lines_per_window_.load(std::memory_order_relaxed))) {
+      slot.suppressed.fetch_add(1, std::memory_order_relaxed);
+      suppressed_.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    auto const suppressed =
+        slot.suppressed.exchange(0, std::memory_order_relaxed);
+    if (push(detail::LogEntry{error, suppressed})) {
+      emitted_.fetch_add(1, std::memory_order_relaxed);
+    } else {
+      dropped_.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+
+  /**
+   * @brief      Wait until the errors queued so far have been written
+   */
+  void flush() const {
+    auto const emitted = emitted_.load(std::memory_order_relaxed);
+    while (written_.load(std::memory_order_acquire) < emitted) {
+      std::this_thread::sleep_for(std::chrono::microseconds{100});
+    }
+  }
+
+  /**
+   * @brief      Forget all keys and counts
+   */
+  void reset() {
+    flush();
+    for (auto& slot : table_) {
+      slot.key.store(0, std::memory_order_relaxed);
+      slot.window_lines.store(0, std::memory_order_relaxed);
+      slot.suppressed.store(0, std::memory_order_relaxed);
+    }
+    emitted_.store(0, std::memory_order_relaxed);
+    written_.store(0, std::memory_order_relaxed);
+    suppressed_.store(0, std::memory_order_relaxed);
+    dropped_.store(0, std::memory_order_relaxed);
+  }
+
+  LogStats stats() const {
+    return {emitted_.load(std::memory_order_relaxed),
+            suppressed_.load(std::memory_order_relaxed),
+            dropped_.load(std::memory_order_relaxed)};
+  }
+};
+
+/**
+ * @brief      Write an error to the log, at most LogPolicy::lines_per_window
+ * times per window for each error code, call of log_error and site where the
+ * error was created (or message when that site is unknown).  Suppressed
+ * errors are counted and the count is added to the next line written for the
+ * key.
+ *
+ * @param[in]  error  The error
+ * @param[in]  site   Where the error is logged
+ */
+inline void log_error(Error const& error,
+                      SourceLocation site = SourceLocation::current()) {
+  ErrorLogger::instance().log(error, site);
+}
+
+/**
+ * @brief      Configure log_error
+ *
+ * @param[in]  policy  The number of lines per window and the window
+ */
+inline void set_log_policy(LogPolicy const& policy) {
+  ErrorLogger::instance().configure(policy);
+}
+
+}  // namespace fp
@@ -28,12 +28,100 @@
 
 #pragma once
 
+#include <exception>
 #include <optional>
+#include <type_traits>
+#include <utility>
 
 #include "fp/_external/expected.hpp"
+#include "fp/compact_optional.hpp"
+#include "fp/result_fwd.hpp"
+
+#ifdef FP_ENABLE_TRACING
+#include "fp/trace.hpp"
+#endif
 
 namespace fp {
 
+namespace detail {
+
+/**
+ * @brief      Invoke a stage of a pipeline.  When FP_ENABLE_TRACING is defined
+ * the call is recorded with fp::trace, otherwise this compiles to a plain call.
+ *
+ * @param[in]  f     The stage
+ * @param[in]  args  The arguments
+ *
+ * @tparam     F     The stage type
+ * @tparam     Args  The argument types
+ *
+ * @return     The return value of f
+ */
+template <typename F, typename... Args>
+constexpr decltype(auto) invoke_stage(F& f, Args&&... args) {
+#ifdef FP_ENABLE_TRACING
+  return trace::invoke(f, std::forward<Args>(args)...);
+#else
+  return f(std::forward<Args>(args)...);
+#endif
+}
+
+template <typename From, typename To, typename = void>
+struct HasErrorConversion : std::false_type {};
+template <typename From, typename To>
+struct HasErrorConversion<
+    From, To,
+    std::void_t<decltype(ErrorConversion<From, To>::convert(
+        std::declval<From>()))>> : std::true_type {};
+
+/**
+ * @brief      Convert an error to To with ErrorConversion<From, To>, or by
+ * constructing a To from it
+ *
+ * @param[in]  error  The error
+ *
+ * @tparam     To     The error type to convert to
+ * @tparam     From   The error type
+ *
+ * @return     The converted error
+ */
+template <typename To, typename From>
+constexpr To convert_error(From&& error) {
+  using Bare = std::remove_cv_t<std::remove_reference_t<From>>;
+  if constexpr (std::is_same_v<Bare, To>) {
+    return std::forward<From>(error);
+  } else if constexpr (HasErrorConversion<Bare, To>::value) {
+    return ErrorConversion<Bare, To>::convert(std::forward<From>(error));
+  } else {
+    static_assert(std::is_constructible_v<To, From&&>,
+                  "no fp::ErrorConversion between the error types");
+    return To(std::forward<From>(error));
+  }
+}
+
+/**
+ * @brief      Make the unexpected returned by mbind for an error of the input,
+ * converted to the error type of Ret if it is a tl::expected
+ *
+ * @param[in]  error  The error of the input
+ *
+ * @tparam     Ret    The return type of the bound function
+ * @tparam     E      The error type
+ *
+ * @return     The unexpected error
+ */
+template <typename Ret, typename E>
+constexpr auto propagate_error(E&& error) {
+  if constexpr (IsExpected<Ret>::value) {
+    return tl::make_unexpected(
+        convert_error<typename Ret::error_type>(std::forward<E>(error)));
+  } else {
+    return tl::make_unexpected(std::forward<E>(error));
+  }
+}
+
+}  // namespace detail
+
 /**
  * @brief      Makes an optional<T> from a T value.
  *
@@ -45,7 +133,7 @@ namespace fp {
  */
 template <typename T>
 constexpr std::optional<T> make_opt(T value) {
-  return std::optional<T>{value};
+  return std::optional<T>{std::move(value)};
 }
 
 /**
@@ -63,14 +151,58 @@ template <typename T, typename F>
 constexpr auto mbind(const std::optional<T>& opt, F f)
     -> decltype(f(opt.value())) {
   if (opt) {
-    return f(opt.value());
+    return detail::invoke_stage(f, opt.value());
+  } else {
+    return {};
+  }
+}
+
+/**
+ * @brief      Monad optional bind for rvalues, moves the value into f
+ *
+ * @param[in]  opt   The input optional
+ * @param[in]  f     The function
+ *
+ * @tparam     T     The input type
+ * @tparam     F     The function
+ *
+ * @return     Return type of f
+ */
+template <typename T, typename F>
+constexpr auto mbind(std::optional<T>&& opt, F f)
+    -> decltype(f(std::move(opt).value())) {
+  if (opt) {
+    return detail::invoke_stage(f, *std::move(opt));
   } else {
     return {};
   }
 }
 
 /**
- * @brief      Monad tl::expected<T,E>
+ * @brief      Monad compact_optional bind
+ *
+ * @param[in]  opt       The input compact_optional
+ * @param[in]  f         The function
+ *
+ * @tparam     T         The input type
+ * @tparam     Sentinel  The sentinel of the input
+ * @tparam     F         The function
+ *
+ * @return     Return type of f
+ */
+template <typename T, typename Sentinel, typename F>
+constexpr auto mbind(const compact_optional<T, Sentinel>& opt, F f)
+    -> decltype(f(*opt)) {
+  if (opt) {
+    return detail::invoke_stage(f, *opt);
+  } else {
+    return {};
+  }
+}
+
+/**
+ * @brief      Monad tl::expected<T,E>.  If f returns a tl::expected with
+ * another error type, the error is converted with fp::ErrorConversion.
  *
  * @param[in]  exp   The tl::expected<T,E> input
  * @param[in]  f     The function to apply
@@ -86,14 +218,59 @@ template <typename T, typename E, typename F,
           typename Ret = typename std::result_of<F(T)>::type>
 constexpr Ret mbind(const tl::expected<T, E>& exp, F f) {
   if (exp) {
-    return f(exp.value());
+    return detail::invoke_stage(f, exp.value());
   }
-  return tl::make_unexpected(exp.error());
+  return detail::propagate_error<Ret>(exp.error());
+}
+
+/**
+ * @brief      Monad tl::expected<T,E> for rvalues, moves the value into f
+ *
+ * @param[in]  exp   The tl::expected<T,E> input
+ * @param[in]  f     The function to apply
+ *
+ * @tparam     T     The type for the input expected
+ * @tparam     E     The error type
+ * @tparam     F     The function
+ * @tparam     Ret   The return type of the function
+ *
+ * @return     The return type of the function
+ */
+template <typename T, typename E, typename F,
+          typename Ret = typename std::result_of<F(T)>::type>
+constexpr Ret mbind(tl::expected<T, E>&& exp, F f) {
+  if (exp) {
+    return detail::invoke_stage(f, std::move(exp).value());
+  }
+  return detail::propagate_error<Ret>(std::move(exp).error());
+}
+
+/**
+ * @brief      Monad tl::expected<void,E>
+ *
+ * @param[in]  exp   The tl::expected<void,E> input
+ * @param[in]  f     The function to apply, takes no arguments
+ *
+ * @tparam     E     The error type
+ * @tparam     F     The function
+ * @tparam     Ret   The return type of the function
+ *
+ * @return     The return type of the function
+ */
+template <typename E, typename F,
+          typename Ret = typename std::result_of<F()>::type>
+constexpr Ret mbind(const tl::expected<void, E>& exp, F f) {
+  if (exp) {
+    return detail::invoke_stage(f);
+  }
+  return detail::propagate_error<Ret>(exp.error());
 }
 
 /**
  * @brief      Monadic try, used to lift a function that throws an
- * exception one that returns an tl::expected<T, std::exception_ptr>
+ * exception one that returns an tl::expected<T, std::exception_ptr>.  A
+ * function returning void or already returning that expected type is lifted
+ * without nesting, and one that cannot throw is called without a try/catch.
  *
  * @param[in]  f     The function to call
  *
@@ -103,13 +280,17 @@ constexpr Ret mbind(const tl::expected<T, E>& exp, F f) {
  *
  * @return     The return value of the function
  */
-template <typename F, typename Ret = typename std::result_of<F()>::type,
-          typename Exp = tl::expected<Ret, std::exception_ptr>>
+template <typename F, typename Ret = std::invoke_result_t<F&>,
+          typename Exp = detail::flatten_t<Ret, std::exception_ptr>>
 Exp mtry(F f) {
-  try {
-    return Exp{f()};
-  } catch (...) {
-    return tl::make_unexpected(std::current_exception());
+  if constexpr (detail::is_nothrow_into_v<Exp, F>) {
+    return detail::invoke_into<Exp>(f);
+  } else {
+    try {
+      return detail::invoke_into<Exp>(f);
+    } catch (...) {
+      return tl::make_unexpected(std::current_exception());
+    }
   }
 }
 
@@ -126,7 +307,10 @@ Exp mtry(F f) {
  */
 template <typename F, typename G>
 constexpr auto mcompose(F f, G g) {
-  return [=](auto value) { return mbind(f(value), g); };
+  return [=](auto&& value) {
+    return mbind(
+        detail::invoke_stage(f, std::forward<decltype(value)>(value)), g);
+  };
 }
 
 /**
@@ -166,6 +350,39 @@ constexpr auto operator|(const std::optional<T>& opt, F f) {
   return fp::mbind(opt, f);
 }
 
+/**
+ * @brief      Overload of the | operator as bind for rvalues
+ *
+ * @param[in]  opt   The input optional, moved into f
+ * @param[in]  f     The function
+ *
+ * @tparam     T     The input type
+ * @tparam     F     The function
+ *
+ * @return     Return type of f
+ */
+template <typename T, typename F>
+constexpr auto operator|(std::optional<T>&& opt, F f) {
+  return fp::mbind(std::move(opt), f);
+}
+
+/**
+ * @brief      Overload of the | operator as bind
+ *
+ * @param[in]  opt       The input compact_optional
+ * @param[in]  f         The function
+ *
+ * @tparam     T         The input type
+ * @tparam     Sentinel  The sentinel of the input
+ * @tparam     F         The function
+ *
+ * @return     Return type of f
+ */
+template <typename T, typename Sentinel, typename F>
+constexpr auto operator|(const fp::compact_optional<T, Sentinel>& opt, F f) {
+  return fp::mbind(opt, f);
+}
+
 /**
  * @brief      Overload of the | operator as bind
  *
@@ -184,3 +401,40 @@ template <typename T, typename E, typename F,
 constexpr Ret operator|(const tl::expected<T, E>& exp, F f) {
   return fp::mbind(exp, f);
 }
+
+/**
+ * @brief      Overload of the | operator as bind for rvalues
+ *
+ * @param[in]  exp   The input tl::expected<T,E> value, moved into f
+ * @param[in]  f     The function to apply
+ *
+ * @tparam     T     The type for the input expected
+ * @tparam     E     The error type
+ * @tparam     F     The function
+ * @tparam     Ret   The return type of the function
+ *
+ * @return     The return type of the function
+ */
+template <typename T, typename E, typename F,
+          typename Ret = typename std::result_of<F(T)>::type>
+constexpr Ret operator|(tl::expected<T, E>&& exp, F f) {
+  return fp::mbind(std::move(exp), f);
+}
+
+/**
+ * @brief      Overload of the | operator as bind for tl::expected<void,E>
+ *
+ * @param[in]  exp   The input tl::expected<void,E> value
+ * @param[in]  f     The function to apply, takes no arguments
+ *
+ * @tparam     E     The error type
+ * @tparam     F     The function
+ * @tparam     Ret   The return type of the function
+ *
+ * @return     The return type of the function
+ */
+template <typename E, typename F,
+          typename Ret = typename std::result_of<F()>::type>
+constexpr Ret operator|(const tl::expected<void, E>& exp, F f) {
+  return fp::mbind(exp, f);
+}
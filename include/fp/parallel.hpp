@@ -0,0 +1,564 @@
+// Copyright (c) 2022, Tyler Weaver
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#pragma once
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <exception>
+#include <iterator>
+#include <limits>
+#include <optional>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "fp/monad.hpp"
+#include "fp/result.hpp"
+#include "fp/thread_pool.hpp"
+
+namespace fp {
+
+/**
+ * @brief      Options for when_all
+ */
+struct WhenAllPolicy {
+  /// Estimated run time of each callable, below inline_threshold they are
+  /// run in order on the calling thread instead of on the pool
+  std::chrono::nanoseconds estimated_work = std::chrono::nanoseconds::max();
+  std::chrono::nanoseconds inline_threshold = std::chrono::microseconds{50};
+  ThreadPool* pool = &ThreadPool::instance();
+};
+
+/**
+ * @brief      Value type of a Result<T> in a tuple, std::monostate for
+ * Result<void>
+ */
+template <typename R>
+using tuple_value_t =
+    std::conditional_t<std::is_void_v<typename R::value_type>, std::monostate,
+                       typename R::value_type>;
+
+/**
+ * @brief      Call f, converting an exception into an Exception error so it
+ * cannot escape a worker thread.  If f may throw, its error type must be
+ * fp::Error or one an fp::Error converts to with fp::ErrorConversion.
+ */
+template <typename F, typename Ret = std::invoke_result_t<F&>>
+Ret invoke_to_result(F& f) noexcept {
+  if constexpr (std::is_nothrow_invocable_v<F&>) {
+    return f();
+  } else {
+    using E = typename Ret::error_type;
+    static_assert(std::is_same_v<E, Error> ||
+                      detail::HasErrorConversion<Error, E>::value ||
+                      std::is_constructible_v<E, Error&&>,
+                  "a callable that may throw must be noexcept or return an "
+                  "error type fp::Error converts to, see fp::ErrorConversion");
+    try {
+      return f();
+    } catch (std::exception const& ex) {
+      return tl::make_unexpected(
+          detail::convert_error<E>(Exception(ex.what())));
+    } catch (...) {
+      return tl::make_unexpected(
+          detail::convert_error<E>(Exception("unknown exception")));
+    }
+  }
+}
+
+namespace detail {
+
+template <typename R>
+tuple_value_t<R> take_value(R&& result) {
+  if constexpr (std::is_void_v<typename R::value_type>) {
+    return std::monostate{};
+  } else {
+    return std::move(result).value();
+  }
+}
+
+template <typename Callables, typename Results, size_t... Is>
+void when_all_run(ThreadPool* pool, bool parallel, Callables& callables,
+                  Results& results, std::index_sequence<Is...>) {
+  auto failed = std::atomic<bool>{false};
+  auto const run = [&failed](auto& f, auto& slot) {
+    if (failed.load(std::memory_order_relaxed)) return;
+    slot.emplace(invoke_to_result(f));
+    if (!slot.value()) failed.store(true, std::memory_order_relaxed);
+  };
+
+  if (!parallel) {
+    (run(std::get<Is>(callables), std::get<Is>(results)), ...);
+    return;
+  }
+
+  auto group = TaskGroup{*pool};
+  ((Is == 0 ? void() : group.run([&] {
+    run(std::get<Is>(callables), std::get<Is>(results));
+  })),
+   ...);
+  run(std::get<0>(callables), std::get<0>(results));
+  group.wait();
+}
+
+/**
+ * @brief      The error type shared by the results of the callables
+ */
+template <typename F, typename... Fs>
+struct WhenAllError {
+  using type = typename std::invoke_result_t<F&>::error_type;
+  static_assert(
+      (std::is_same_v<type, typename std::invoke_result_t<Fs&>::error_type> &&
+       ...),
+      "when_all requires the callables to have the same error type");
+};
+
+template <typename... Fs>
+using when_all_error_t = typename WhenAllError<Fs...>::type;
+
+template <typename Tuple, typename E, typename Results, size_t... Is>
+Result<Tuple, E> when_all_collect(Results& results,
+                                  std::index_sequence<Is...>) {
+  auto error = std::optional<E>{};
+  auto const check = [&error](auto const& slot) {
+    if (!error && slot && !slot.value()) error = slot.value().error();
+  };
+  (check(std::get<Is>(results)), ...);
+  if (error) return tl::make_unexpected(std::move(error).value());
+  return Tuple{take_value(std::move(std::get<Is>(results)).value())...};
+}
+
+}  // namespace detail
+
+/**
+ * @brief      Runs independent callables returning Result<T, E> with the same
+ * error type E concurrently on a thread pool.  Once one of them returns an
+ * error the ones that have not started yet are skipped, the ones already
+ * running are not interrupted.  The first callable runs on the calling
+ * thread.  If the estimated work is below the inline threshold they are all
+ * run in order on the calling thread.
+ *
+ * @param[in]  policy  The thread pool and work estimate
+ * @param[in]  fs      The callables, taking no arguments
+ *
+ * @tparam     Fs      The callable types
+ *
+ * @return     A tuple of the values or the error of the first callable, in
+ * argument order, that failed
+ */
+template <typename... Fs>
+Result<std::tuple<tuple_value_t<std::invoke_result_t<Fs&>>...>,
+       detail::when_all_error_t<Fs...>>
+when_all(WhenAllPolicy const& policy, Fs... fs) {
+  using Tuple = std::tuple<tuple_value_t<std::invoke_result_t<Fs&>>...>;
+  auto results = std::tuple<std::optional<std::invoke_result_t<Fs&>>...>{};
+  auto callables = std::forward_as_tuple(fs...);
+  auto const parallel = sizeof...(Fs) > 1 && policy.pool != nullptr &&
+                        policy.estimated_work >= policy.inline_threshold;
+  detail::when_all_run(policy.pool, parallel, callables, results,
+                       std::index_sequence_for<Fs...>{});
+  return detail::when_all_collect<Tuple, detail::when_all_error_t<Fs...>>(
+      results, std::index_sequence_for<Fs...>{});
+}
+
+/**
+ * @brief      Runs independent callables returning Result<T, E> concurrently
+ * on the shared thread pool
+ *
+ * @param[in]  f   The first callable
+ * @param[in]  fs  The other callables
+ *
+ * @return     A tuple of the values or the error of the first callable, in
+ * argument order, that failed
+ */
+template <typename F, typename... Fs,
+          typename = std::enable_if_t<!std::is_same_v<F, WhenAllPolicy>>>
+auto when_all(F f, Fs... fs) {
+  return when_all(WhenAllPolicy{}, f, fs...);
+}
+
+/**
+ * @brief      Options for par_validate
+ */
+struct ValidatePolicy {
+  /// Number of consecutive elements a thread claims at a time
+  size_t grain_size = 16384;
+  ThreadPool* pool = &ThreadPool::instance();
+  /// Name passed to validators taking (value, name)
+  std::string name = "value";
+};
+
+/**
+ * @brief      A validation failure and the index of the element
+ */
+struct IndexedError {
+  size_t index;
+  Error error;
+};
+
+namespace detail {
+
+template <typename Validator, typename T>
+auto call_validator(Validator const& validator, T const& value,
+                    std::string const& name) {
+  if constexpr (std::is_invocable_v<Validator const&, T const&>) {
+    return validator(value);
+  } else {
+    return validator(value, name);
+  }
+}
+
+template <typename Policy>
+size_t grain_workers(size_t size, Policy const& policy) {
+  auto const grain = std::max<size_t>(policy.grain_size, 1);
+  auto const grains = (size + grain - 1) / grain;
+  if (policy.pool == nullptr) return std::min<size_t>(grains, 1);
+  return std::min(grains, policy.pool->size() + 1);
+}
+
+/**
+ * @brief      Calls body(worker, begin, end) for consecutive grains of
+ * [0, size).  Each worker claims the next grain from a shared counter until
+ * they are exhausted or body returns false, so faster threads take more
+ * grains.  Worker 0 is the calling thread.
+ */
+template <typename Policy, typename Body>
+void for_each_grain(size_t size, size_t workers, Policy const& policy,
+                    Body const& body) {
+  auto const grain = std::max<size_t>(policy.grain_size, 1);
+  auto next = std::atomic<size_t>{0};
+  auto const work = [&](size_t worker) {
+    for (auto begin = next.fetch_add(grain, std::memory_order_relaxed);
+         begin < size;
+         begin = next.fetch_add(grain, std::memory_order_relaxed)) {
+      if (!body(worker, begin, std::min(begin + grain, size))) return;
+    }
+  };
+
+  if (workers <= 1) {
+    work(0);
+    return;
+  }
+  auto group = TaskGroup{*policy.pool};
+  for (size_t worker = 1; worker < workers; ++worker) {
+    group.run([&work, worker] { work(worker); });
+  }
+  work(0);
+  group.wait();
+}
+
+template <typename It, typename = void>
+struct IsRandomAccess : std::false_type {};
+template <typename It>
+struct IsRandomAccess<It, std::void_t<decltype(std::declval<It>()[0]),
+                                      decltype(std::declval<It>() -
+                                               std::declval<It>())>>
+    : std::true_type {};
+
+/**
+ * @brief      Begin of a range that can be indexed.  Checks the operations
+ * rather than the iterator category, which is input for a view producing
+ * prvalues (like views::transform) even when it can be indexed.
+ */
+template <typename Rng>
+auto random_access_begin(Rng const& range) {
+  auto first = std::begin(range);
+  static_assert(IsRandomAccess<decltype(first)>::value,
+                "requires a random access range");
+  return first;
+}
+
+}  // namespace detail
+
+/**
+ * @brief      Validate the elements of a range in parallel on a thread pool
+ *
+ * @param[in]  range      A random access range
+ * @param[in]  validator  Called with (value) or (value, policy.name),
+ * returning a Result; called concurrently
+ * @param[in]  policy     The grain size and thread pool
+ *
+ * @return     The error of the lowest index that failed with the index added
+ * as context, regardless of thread timing
+ */
+template <typename Rng, typename Validator>
+Result<void> par_validate(Rng const& range, Validator const& validator,
+                          ValidatePolicy const& policy = {}) {
+  auto const first = detail::random_access_begin(range);
+  auto const size = static_cast<size_t>(std::distance(first, std::end(range)));
+  auto const workers = detail::grain_workers(size, policy);
+  auto failures = std::vector<std::optional<IndexedError>>(workers);
+  auto lowest = std::atomic<size_t>{std::numeric_limits<size_t>::max()};
+
+  // Grains are claimed in increasing order and the grain holding the lowest
+  // failure is never skipped, so the result is deterministic.
+  detail::for_each_grain(
+      size, workers, policy, [&](size_t worker, size_t begin, size_t end) {
+        if (begin > lowest.load(std::memory_order_relaxed)) return false;
+        for (auto index = begin; index < end; ++index) {
+          auto result = detail::call_validator(
+              validator, first[static_cast<std::ptrdiff_t>(index)],
+              policy.name);
+          if (!result) {
+            failures[worker] = IndexedError{index, std::move(result).error()};
+            auto expected = lowest.load(std::memory_order_relaxed);
+            while (index < expected &&
+                   !lowest.compare_exchange_weak(expected, index)) {
+            }
+            return false;
+          }
+        }
+        return true;
+      });
+
+  auto* failure = static_cast<IndexedError*>(nullptr);
+  for (auto& candidate : failures) {
+    if (candidate &&
+        (failure == nullptr || candidate->index < failure->index)) {
+      failure = &candidate.value();
+    }
+  }
+  if (failure == nullptr) return {};
+  return tl::make_unexpected(
+      with_context(std::move(failure->error), "at index {}", failure->index));
+}
+
+/**
+ * @brief      Validate all elements of a range in parallel on a thread pool
+ *
+ * @param[in]  range      A random access range
+ * @param[in]  validator  Called with (value) or (value, policy.name),
+ * returning a Result; called concurrently
+ * @param[in]  policy     The grain size and thread pool
+ *
+ * @return     Every failure ordered by index, empty if all are valid
+ */
+template <typename Rng, typename Validator>
+std::vector<IndexedError> par_validate_all(Rng const& range,
+                                           Validator const& validator,
+                                           ValidatePolicy const& policy = {}) {
+  auto const first = detail::random_access_begin(range);
+  auto const size = static_cast<size_t>(std::distance(first, std::end(range)));
+  auto const workers = detail::grain_workers(size, policy);
+  auto failures = std::vector<std::vector<IndexedError>>(workers);
+
+  detail::for_each_grain(
+      size, workers, policy, [&](size_t worker, size_t begin, size_t end) {
+        for (auto index = begin; index < end; ++index) {
+          auto result = detail::call_validator(
+              validator, first[static_cast<std::ptrdiff_t>(index)],
+              policy.name);
+          if (!result) {
+            failures[worker].push_back(
+                IndexedError{index, std::move(result).error()});
+          }
+        }
+        return true;
+      });
+
+  auto all = std::vector<IndexedError>{};
+  for (auto& worker_failures : failures) {
+    std::move(worker_failures.begin(), worker_failures.end(),
+              std::back_inserter(all));
+  }
+  std::sort(all.begin(), all.end(),
+            [](IndexedError const& lhs, IndexedError const& rhs) {
+              return lhs.index < rhs.index;
+            });
+  return all;
+}
+
+/**
+ * @brief      How reduce_results handles elements that are errors
+ */
+enum class ReduceErrors {
+  FAIL_FAST,  ///< stop and return the error with the lowest index
+  SKIP,       ///< reduce the values and count the errors
+};
+
+/**
+ * @brief      Options for reduce_results
+ */
+struct ReducePolicy {
+  ReduceErrors errors = ReduceErrors::FAIL_FAST;
+  /// Number of consecutive elements reduced in order into one partial
+  size_t grain_size = 16384;
+  ThreadPool* pool = &ThreadPool::instance();
+};
+
+/**
+ * @brief      The value of reduce_results and how many elements went into it
+ */
+template <typename T>
+struct Reduction {
+  T value;
+  size_t reduced = 0;  ///< number of values reduced
+  size_t skipped = 0;  ///< number of errors skipped
+};
+
+namespace detail {
+
+/**
+ * @brief      Partial reduction of one grain, on its own cache line so
+ * threads finishing neighbouring grains do not share lines
+ */
+template <typename T>
+struct alignas(64) ReducePartial {
+  std::optional<T> value;
+  size_t reduced = 0;
+  size_t skipped = 0;
+};
+
+}  // namespace detail
+
+/**
+ * @brief      Reduce the values of a range of Results in parallel with an
+ * associative op.  Each grain of policy.grain_size elements is reduced in
+ * order into a partial, then the partials are combined pairwise in a fixed
+ * tree and the total is combined with init.  The grouping depends only on the
+ * size and grain size, not on thread timing or the pool, so floating point
+ * results are the same on every run.
+ *
+ * @param[in]  range   A random access range of Result<T>, transform the
+ * elements first to reduce into another type (for example to count them)
+ * @param[in]  init    The initial value, combined with the total once
+ * @param[in]  op      Associative, called with (T, T) returning T; called
+ * concurrently
+ * @param[in]  policy  How to handle errors, the grain size and thread pool
+ *
+ * @tparam     Rng     The range type
+ * @tparam     T       The type of the reduction
+ * @tparam     Op      The operation type
+ *
+ * @return     The reduction, or with ReduceErrors::FAIL_FAST the error of the
+ * lowest index with the index added as context
+ */
+template <typename Rng, typename T, typename Op>
+auto reduce_results(Rng const& range, T init, Op const& op,
+                    ReducePolicy const& policy = {}) {
+  using Reference = decltype(*std::begin(range));
+  using E = typename std::decay_t<Reference>::error_type;
+  using Return = Result<Reduction<T>, E>;
+  static_assert(
+      std::is_same_v<typename std::decay_t<Reference>::value_type, T>,
+      "reduce_results requires the value type of the results to be the type "
+      "of init, transform the range first");
+
+  auto const first = detail::random_access_begin(range);
+  auto const size = static_cast<size_t>(std::distance(first, std::end(range)));
+  auto const grain = std::max<size_t>(policy.grain_size, 1);
+  auto const workers = detail::grain_workers(size, policy);
+  auto partials =
+      std::vector<detail::ReducePartial<T>>((size + grain - 1) / grain);
+  auto failures = std::vector<std::optional<std::pair<size_t, E>>>(workers);
+  auto lowest = std::atomic<size_t>{std::numeric_limits<size_t>::max()};
+  auto const fail_fast = policy.errors == ReduceErrors::FAIL_FAST;
+
+  detail::for_each_grain(
+      size, workers, policy, [&](size_t worker, size_t begin, size_t end) {
+        if (fail_fast && begin > lowest.load(std::memory_order_relaxed)) {
+          return false;
+        }
+        auto& partial = partials[begin / grain];
+        for (auto index = begin; index < end; ++index) {
+          auto&& result = first[static_cast<std::ptrdiff_t>(index)];
+          if (!result) {
+            if (!fail_fast) {
+              ++partial.skipped;
+              continue;
+            }
+            failures[worker].emplace(index, result.error());
+            auto expected = lowest.load(std::memory_order_relaxed);
+            while (index < expected &&
+                   !lowest.compare_exchange_weak(expected, index)) {
+            }
+            return false;
+          }
+          auto&& value = std::forward<decltype(result)>(result).value();
+          if (partial.value) {
+            partial.value = op(std::move(*partial.value),
+                               std::forward<decltype(value)>(value));
+          } else {
+            partial.value.emplace(std::forward<decltype(value)>(value));
+          }
+          ++partial.reduced;
+        }
+        return true;
+      });
+
+  if (fail_fast) {
+    auto* failure = static_cast<std::pair<size_t, E>*>(nullptr);
+    for (auto& candidate : failures) {
+      if (candidate &&
+          (failure == nullptr || candidate->first < failure->first)) {
+        failure = &candidate.value();
+      }
+    }
+    if (failure != nullptr) {
+      return Return{tl::make_unexpected(with_context(
+          std::move(failure->second), "at index {}", failure->first))};
+    }
+  }
+
+  for (size_t stride = 1; stride < partials.size(); stride *= 2) {
+    for (size_t i = 0; i + stride < partials.size(); i += 2 * stride) {
+      auto& left = partials[i];
+      auto& right = partials[i + stride];
+      if (left.value && right.value) {
+        left.value = op(std::move(*left.value), std::move(*right.value));
+      } else if (right.value) {
+        left.value = std::move(right.value);
+      }
+      left.reduced += right.reduced;
+      left.skipped += right.skipped;
+    }
+  }
+
+  auto reduction = Reduction<T>{std::move(init)};
+  if (!partials.empty()) {
+    auto& total = partials.front();
+    if (total.value) {
+      reduction.value =
+          op(std::move(reduction.value), std::move(*total.value));
+    }
+    reduction.reduced = total.reduced;
+    reduction.skipped = total.skipped;
+  }
+  return Return{std::move(reduction)};
+}
+
+}  // namespace fp
@@ -0,0 +1,276 @@
+// Copyright (c) 2022, Tyler Weaver
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <fmt/format.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+#include "fp/result.hpp"
+
+namespace fp::pmr {
+
+namespace detail {
+inline std::pmr::memory_resource*& thread_resource() noexcept {
+  thread_local std::pmr::memory_resource* resource = nullptr;
+  return resource;
+}
+}  // namespace detail
+
+/**
+ * @brief      The memory resource errors created on this thread allocate
+ * from, std::pmr::get_default_resource() unless one is installed
+ */
+inline std::pmr::memory_resource* current_resource() noexcept {
+  auto* const resource = detail::thread_resource();
+  return resource != nullptr ? resource : std::pmr::get_default_resource();
+}
+
+/**
+ * @brief      Install the memory resource errors created on this thread
+ * allocate from
+ *
+ * @param[in]  resource  The resource, nullptr for the default resource
+ *
+ * @return     The previously installed resource
+ */
+inline std::pmr::memory_resource* set_thread_resource(
+    std::pmr::memory_resource* resource) noexcept {
+  return std::exchange(detail::thread_resource(), resource);
+}
+
+/**
+ * @brief      Allocator using a std::pmr::memory_resource.  Unlike
+ * std::pmr::polymorphic_allocator, default construction and container copies
+ * use the resource of the current thread so copies of an error stay in the
+ * arena of the thread making them.
+ *
+ * @tparam     T     The value type
+ */
+template <typename T>
+class Allocator {
+  std::pmr::memory_resource* resource_;
+
+ public:
+  using value_type = T;
+
+  Allocator() noexcept : resource_(current_resource()) {}
+  Allocator(std::pmr::memory_resource* resource) noexcept
+      : resource_(resource) {}
+  template <typename U>
+  Allocator(Allocator<U> const& other) noexcept
+      : resource_(other.resource()) {}
+
+  T* allocate(size_t n) {
+    return static_cast<T*>(resource_->allocate(n * sizeof(T), alignof(T)));
+  }
+  void deallocate(T* p, size_t n) noexcept {
+    resource_->deallocate(p, n * sizeof(T), alignof(T));
+  }
+
+  Allocator select_on_container_copy_construction() const noexcept {
+    return Allocator{};
+  }
+
+  std::pmr::memory_resource* resource() const noexcept { return resource_; }
+
+  template <typename U>
+  bool operator==(Allocator<U> const& other) const noexcept {
+    return resource_->is_equal(*other.resource());
+  }
+  template <typename U>
+  bool operator!=(Allocator<U> const& other) const noexcept {
+    return !(*this == other);
+  }
+};
+
+/**
+ * @brief      String allocating from the current thread's memory resource
+ */
+using string = std::basic_string<char, std::char_traits<char>, Allocator<char>>;
+
+/**
+ * @brief      Error with the message allocated from a memory resource
+ */
+using Error = BasicError<string>;
+
+/**
+ * @brief      Result<T> with the message of the error allocated from a memory
+ * resource
+ */
+template <typename T>
+using Result = tl::expected<T, Error>;
+
+/**
+ * @brief      Make an Error allocating the message from the current thread's
+ * memory resource
+ *
+ * @param[in]  code      The error code
+ * @param[in]  what      The message
+ * @param[in]  location  Where the error was created
+ *
+ * @return     The error
+ */
+inline Error make_error(ErrorCode code, std::string_view what = "",
+                        SourceLocation location = SourceLocation::current()) {
+  return fp::detail::make_basic_error(code, string{what}, location);
+}
+
+/**
+ * @brief      Make an Error from a code of an error domain allocating the
+ * message from the current thread's memory resource, see fp::make_error
+ *
+ * @param[in]  code      The domain code
+ * @param[in]  what      The message
+ * @param[in]  location  Where the error was created
+ *
+ * @tparam     Enum      The domain enum, see ErrorDomain
+ *
+ * @return     The error
+ */
+template <typename Enum,
+          typename = std::enable_if_t<is_error_domain_v<Enum>>>
+Error make_error(Enum code, std::string_view what = "",
+                 SourceLocation location = SourceLocation::current()) {
+  return fp::detail::make_domain_error(code, string{what}, location);
+}
+
+/**
+ * @brief      Make an Error formatting the message directly into the current
+ * thread's memory resource, without a temporary std::string
+ *
+ * @param[in]  code    The error code
+ * @param[in]  format  The format string literal and where the error was
+ * created
+ * @param[in]  args    The format arguments
+ *
+ * @return     The error
+ */
+template <typename... Args>
+Error format_error(ErrorCode code, ContextMessage format,
+                   Args const&... args) {
+  auto error = pmr::make_error(code, "", format.location);
+  fmt::vformat_to(std::back_inserter(error.what), format.message,
+                  fmt::make_format_args(args...));
+  return error;
+}
+
+/**
+ * @brief      Copy an error into one whose message is a std::string, so it can
+ * outlive the memory resource
+ *
+ * @param[in]  error  The error
+ *
+ * @return     The error with the same code, message, context and location
+ */
+template <typename String>
+fp::Error to_error(BasicError<String> const& error) {
+  return fp::Error{error.code, std::string{error.what}, error.context,
+                   error.location, error.backtrace, error.domain};
+}
+
+/**
+ * @brief      Copy an error into one whose message is allocated from the
+ * current thread's memory resource
+ *
+ * @param[in]  error  The error
+ *
+ * @return     The error with the same code, message, context and location
+ */
+inline Error from_error(fp::Error const& error) {
+  return Error{error.code, string{error.what}, error.context,
+               error.location, error.backtrace, error.domain};
+}
+
+/**
+ * @brief      Monotonic arena for the errors created on this thread during a
+ * request or cycle.  While it is alive it is installed as the thread's memory
+ * resource, messages are bump allocated and freed all at once by release() or
+ * when the arena is destroyed.  Errors must not outlive the release, use
+ * to_error to keep one.
+ */
+class ErrorArena {
+  std::pmr::monotonic_buffer_resource resource_;
+  std::pmr::memory_resource* previous_;
+
+ public:
+  /**
+   * @brief      Create the arena and install it on this thread
+   *
+   * @param[in]  initial_size  Size of the first block requested from upstream
+   * @param[in]  upstream      Where the blocks come from
+   */
+  explicit ErrorArena(
+      size_t initial_size = 4096,
+      std::pmr::memory_resource* upstream = std::pmr::get_default_resource())
+      : resource_(initial_size, upstream),
+        previous_(set_thread_resource(&resource_)) {}
+  ErrorArena(ErrorArena const&) = delete;
+  ErrorArena& operator=(ErrorArena const&) = delete;
+
+  /**
+   * @brief      Restores the previously installed resource
+   */
+  ~ErrorArena() { set_thread_resource(previous_); }
+
+  /**
+   * @brief      Free every message allocated from the arena at once
+   */
+  void release() { resource_.release(); }
+
+  std::pmr::memory_resource* resource() noexcept { return &resource_; }
+};
+
+}  // namespace fp::pmr
+
+namespace fp {
+
+/**
+ * @brief      Converts errors between fp::pmr::Error and fp::Error when binding
+ * functions returning one to a Result of the other
+ */
+template <>
+struct ErrorConversion<pmr::Error, Error> {
+  static Error convert(pmr::Error const& error) { return pmr::to_error(error); }
+};
+template <>
+struct ErrorConversion<Error, pmr::Error> {
+  static pmr::Error convert(Error const& error) {
+    return pmr::from_error(error);
+  }
+};
+
+}  // namespace fp
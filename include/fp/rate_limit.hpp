@@ -0,0 +1,180 @@
+// Copyright (c) 2022, Tyler Weaver
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+
+#include "fp/result.hpp"
+
+namespace fp {
+
+/**
+ * @brief      Counts of a rate limiter
+ */
+struct RateLimiterStats {
+  uint64_t accepted;  ///< Calls passed on to the function
+  uint64_t rejected;  ///< Calls that returned ResourceExhausted
+};
+
+namespace detail {
+
+/**
+ * @brief      Token bucket shared by the copies of a rate limiter, stored as
+ * the single word theoretical arrival time of the generic cell rate algorithm.
+ * Taking a token is one compare and swap of that word.
+ */
+template <typename Clock>
+class RateLimiterState {
+  int64_t interval_;   ///< Nanoseconds per token
+  int64_t tolerance_;  ///< Nanoseconds of burst
+  int64_t max_wait_;
+  Clock clock_;
+  std::atomic<int64_t> arrival_{std::numeric_limits<int64_t>::min()};
+  std::atomic<uint64_t> accepted_{0};
+  std::atomic<uint64_t> rejected_{0};
+
+  static double checked_rate(double rate) {
+    if (!(rate > 0)) {
+      throw std::invalid_argument("rate_limit rate must be positive");
+    }
+    return rate;
+  }
+
+  /// At least 1 so a rate over 1e9/s still limits, and at most about 30
+  /// years so arrival times cannot overflow
+  static int64_t to_nanoseconds(double nanoseconds) {
+    return static_cast<int64_t>(std::clamp(nanoseconds, 1.0, 1e18));
+  }
+
+ public:
+  RateLimiterState(double rate, uint32_t burst,
+                   std::chrono::nanoseconds max_wait, Clock clock)
+      : interval_(to_nanoseconds(1e9 / checked_rate(rate))),
+        tolerance_(to_nanoseconds(static_cast<double>(interval_) *
+                                  std::max<uint32_t>(burst, 1))),
+        max_wait_(max_wait.count()),
+        clock_(std::move(clock)) {}
+
+  /**
+   * @brief      Take a token
+   *
+   * @return     Nanoseconds to wait before the call may run, negative if it
+   * is rejected
+   */
+  int64_t acquire() {
+    auto const now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                         clock_.now().time_since_epoch())
+                         .count();
+    auto arrival = arrival_.load(std::memory_order_relaxed);
+    while (true) {
+      auto const next = std::max(arrival, now) + interval_;
+      auto const wait = std::max<int64_t>(next - now - tolerance_, 0);
+      if (wait > max_wait_) {
+        rejected_.fetch_add(1, std::memory_order_relaxed);
+        return -1;
+      }
+      if (arrival_.compare_exchange_weak(arrival, next,
+                                         std::memory_order_relaxed)) {
+        accepted_.fetch_add(1, std::memory_order_relaxed);
+        return wait;
+      }
+    }
+  }
+
+  RateLimiterStats stats() const {
+    return {accepted_.load(std::memory_order_relaxed),
+            rejected_.load(std::memory_order_relaxed)};
+  }
+};
+
+}  // namespace detail
+
+/**
+ * @brief      Function wrapped by a rate limiter.  Copies share the limiter.
+ *
+ * @tparam     F      The function type, returning a Result
+ * @tparam     Clock  Provides now(), std::chrono::steady_clock by default
+ */
+template <typename F, typename Clock = std::chrono::steady_clock>
+struct RateLimited {
+  std::shared_ptr<detail::RateLimiterState<Clock>> limiter;
+  F f;
+
+  template <typename... Args>
+  auto operator()(Args&&... args) const
+      -> decltype(f(std::forward<Args>(args)...)) {
+    auto const wait = limiter->acquire();
+    if (wait < 0) {
+      return tl::make_unexpected(ResourceExhausted("rate limit exceeded"));
+    }
+    if (wait > 0) std::this_thread::sleep_for(std::chrono::nanoseconds{wait});
+    return f(std::forward<Args>(args)...);
+  }
+
+  RateLimiterStats stats() const { return limiter->stats(); }
+};
+
+/**
+ * @brief      Wrap a function returning a Result with a token bucket.  Calls
+ * over the rate return ResourceExhausted without calling f.
+ *
+ * @param[in]  f         The function
+ * @param[in]  rate      Tokens added per second, throws
+ * std::invalid_argument if it is not positive
+ * @param[in]  burst     Tokens the bucket holds, calls allowed at once
+ * @param[in]  max_wait  How long a call may wait for a token before it is
+ * rejected, by default it never waits
+ * @param[in]  clock     The clock, injectable for testing
+ *
+ * @tparam     F         The function type
+ * @tparam     Clock     The clock type
+ *
+ * @return     The wrapped function, usable as a stage with operator| and
+ * mcompose
+ */
+template <typename F, typename Clock = std::chrono::steady_clock>
+RateLimited<F, Clock> rate_limit(
+    F f, double rate, uint32_t burst,
+    std::chrono::nanoseconds max_wait = std::chrono::nanoseconds{0},
+    Clock clock = {}) {
+  return RateLimited<F, Clock>{
+      std::make_shared<detail::RateLimiterState<Clock>>(rate, burst, max_wait,
+                                                        std::move(clock)),
+      std::move(f)};
+}
+
+}  // namespace fp
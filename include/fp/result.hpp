@@ -31,14 +31,26 @@
 #include <cxxabi.h>
 #include <fmt/format.h>
 
-#include <iostream>
-#include <map>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <initializer_list>
+#include <memory>
 #include <optional>
 #include <string>
 #include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 #include "fp/_external/expected.hpp"
+#include "fp/context.hpp"
+#include "fp/error_domain.hpp"
+#include "fp/expected_ref.hpp"
 #include "fp/no_discard.hpp"
+#include "fp/result_fwd.hpp"
 
 namespace fp {
 
@@ -66,72 +78,310 @@ enum class ErrorCode : int {
 };
 
 /**
- * @brief      Error type used by Result<T>
+ * @brief      Hash of an error message, reading it 8 bytes at a time.  Never 0.
+ *
+ * @param[in]  message  The message
+ *
+ * @return     The hash
+ */
+inline uint64_t hash_message(std::string_view message) noexcept {
+  auto hash = 0x9E3779B97F4A7C15ULL ^ message.size();
+  size_t i = 0;
+  for (; i + 8 <= message.size(); i += 8) {
+    uint64_t word;
+    std::memcpy(&word, message.data() + i, sizeof(word));
+    hash = (hash ^ word) * 0xFF51AFD7ED558CCDULL;
+    hash ^= hash >> 32;
+  }
+  if (i < message.size()) {
+    uint64_t tail = 0;
+    std::memcpy(&tail, message.data() + i, message.size() - i);
+    hash = (hash ^ tail) * 0xFF51AFD7ED558CCDULL;
+  }
+  hash = (hash ^ (hash >> 33)) * 0xC4CEB9FE1A85EC53ULL;
+  hash ^= hash >> 33;
+  return hash == 0 ? 1 : hash;
+}
+
+struct Backtrace;
+
+namespace detail {
+
+/**
+ * @brief      Backtrace capture and formatting, installed by
+ * fp::set_backtrace_policy from fp/backtrace.hpp so that including this header
+ * does not pull in the unwinding and symbolizing headers.  Capturing is off
+ * while sample is null.
+ */
+struct BacktraceHooks {
+  std::atomic<std::shared_ptr<Backtrace const> (*)(ErrorCode)> sample{nullptr};
+  std::atomic<std::string (*)(Backtrace const&)> format{nullptr};
+};
+
+inline BacktraceHooks backtrace_hooks = {};
+
+}  // namespace detail
+
+/**
+ * @brief      Error with the message stored in String.  Only code, domain and
+ * what are part of equality.  An error made from a domain enum also has its
+ * DomainCode, and code is the domain's canonical ErrorCode for it.
+ *
+ * @tparam     String  The type of the message, see fp::pmr::Error for one
+ * allocating from a memory resource
  */
-struct [[nodiscard]] Error {
+template <typename String>
+struct [[nodiscard]] BasicError {
   ErrorCode code = ErrorCode::UNKNOWN;
-  std::string what = "";
+  String what = String{};
+  ContextChain context = {};
+  SourceLocation location = {};
+  std::shared_ptr<Backtrace const> backtrace = nullptr;
+  DomainCode domain = {};
 
-  inline bool operator==(const Error& other) const noexcept {
-    return code == other.code && what == other.what;
+  inline bool operator==(const BasicError& other) const noexcept {
+    return code == other.code && domain == other.domain && what == other.what;
   }
-  inline bool operator!=(const Error& other) const noexcept {
-    return code != other.code || what != other.what;
+  inline bool operator!=(const BasicError& other) const noexcept {
+    return !(*this == other);
   }
 };
 
-constexpr auto Unknown = [](const std::string& what = "") {
-  return Error{ErrorCode::UNKNOWN, what};
-};
-constexpr auto Cancelled = [](const std::string& what = "") {
-  return Error{ErrorCode::CANCELLED, what};
-};
-constexpr auto InvalidArgument = [](const std::string& what = "") {
-  return Error{ErrorCode::INVALID_ARGUMENT, what};
-};
-constexpr auto Timeout = [](const std::string& what = "") {
-  return Error{ErrorCode::TIMEOUT, what};
-};
-constexpr auto NotFound = [](const std::string& what = "") {
-  return Error{ErrorCode::NOT_FOUND, what};
-};
-constexpr auto AlreadyExists = [](const std::string& what = "") {
-  return Error{ErrorCode::ALREADY_EXISTS, what};
-};
-constexpr auto PermissionDenied = [](const std::string& what = "") {
-  return Error{ErrorCode::PERMISSION_DENIED, what};
-};
-constexpr auto ResourceExhausted = [](const std::string& what = "") {
-  return Error{ErrorCode::RESOURCE_EXHAUSTED, what};
-};
-constexpr auto FailedPrecondition = [](const std::string& what = "") {
-  return Error{ErrorCode::FAILED_PRECONDITION, what};
-};
-constexpr auto Aborted = [](const std::string& what = "") {
-  return Error{ErrorCode::ABORTED, what};
-};
-constexpr auto OutOfRange = [](const std::string& what = "") {
-  return Error{ErrorCode::OUT_OF_RANGE, what};
-};
-constexpr auto Unimplemented = [](const std::string& what = "") {
-  return Error{ErrorCode::UNIMPLEMENTED, what};
-};
-constexpr auto Internal = [](const std::string& what = "") {
-  return Error{ErrorCode::INTERNAL, what};
-};
-constexpr auto Unavailable = [](const std::string& what = "") {
-  return Error{ErrorCode::UNAVAILABLE, what};
-};
-constexpr auto DataLoss = [](const std::string& what = "") {
-  return Error{ErrorCode::DATA_LOSS, what};
-};
-constexpr auto Unauthenticated = [](const std::string& what = "") {
-  return Error{ErrorCode::UNAUTHENTICATED, what};
-};
-constexpr auto Exception = [](const std::string& what = "") {
-  return Error{ErrorCode::EXCEPTION, what};
+/**
+ * @brief      Bit mask with a bit set for each of the error codes
+ *
+ * @param[in]  codes  The error codes
+ *
+ * @return     The mask
+ */
+constexpr uint64_t error_code_mask(std::initializer_list<ErrorCode> codes) {
+  uint64_t mask = 0;
+  for (auto const code : codes) mask |= uint64_t{1} << static_cast<int>(code);
+  return mask;
+}
+
+/**
+ * @brief      True if the bit for code is set in mask
+ */
+constexpr bool in_error_code_mask(uint64_t mask, ErrorCode code) {
+  return (mask >> static_cast<int>(code)) & 1U;
+}
+
+namespace detail {
+
+/**
+ * @brief      Make an error with any message type, capturing a backtrace if
+ * it is sampled by the backtrace policy
+ */
+template <typename String>
+BasicError<String> make_basic_error(ErrorCode code, String what,
+                                    SourceLocation location) {
+  auto error = BasicError<String>{code, std::move(what), {}, location};
+  if (auto* const sample =
+          detail::backtrace_hooks.sample.load(std::memory_order_relaxed)) {
+    error.backtrace = sample(code);
+  }
+  return error;
+}
+
+/**
+ * @brief      Make an error with any message type from a code of an error
+ * domain, with the domain's canonical code and the domain code
+ */
+template <typename String, typename Enum>
+BasicError<String> make_domain_error(Enum code, String what,
+                                     SourceLocation location) {
+  auto error = make_basic_error(ErrorDomain<Enum>::canonical(code),
+                                std::move(what), location);
+  error.domain = domain_code(code);
+  return error;
+}
+
+}  // namespace detail
+
+/**
+ * @brief      Make an Error, capturing a backtrace if it is sampled by the
+ * backtrace policy
+ *
+ * @param[in]  code      The error code
+ * @param[in]  what      The message
+ * @param[in]  location  Where the error was created
+ *
+ * @return     The error
+ */
+inline Error make_error(ErrorCode code, std::string const& what,
+                        SourceLocation location) {
+  return detail::make_basic_error(code, what, location);
+}
+
+/**
+ * @brief      Make an Error from a code of an error domain.  The error code is
+ * the domain's canonical code so generic handling still works, and the domain
+ * code can be compared with error.domain == code.
+ *
+ * @param[in]  code      The domain code
+ * @param[in]  what      The message
+ * @param[in]  location  Where the error was created
+ *
+ * @tparam     Enum      The domain enum, see ErrorDomain
+ *
+ * @return     The error
+ */
+template <typename Enum,
+          typename = std::enable_if_t<is_error_domain_v<Enum>>>
+Error make_error(Enum code, std::string const& what = "",
+                 SourceLocation location = SourceLocation::current()) {
+  return detail::make_domain_error(code, what, location);
+}
+
+/**
+ * @brief      Widens a code of an error domain to an Error when a Result<T,
+ * Enum> is bound to a function returning a Result<U>.  The message is left
+ * empty, the formatter writes the domain code, so this does not allocate.
+ */
+template <typename Enum>
+struct ErrorConversion<Enum, Error, std::enable_if_t<is_error_domain_v<Enum>>> {
+  static Error convert(Enum code) {
+    return make_error(code, std::string{}, SourceLocation{});
+  }
 };
 
+/**
+ * Factories for an Error of each ErrorCode.  The location of the call is
+ * captured without any formatting and written when formatting with {:l}.
+ */
+constexpr auto Unknown =
+    [](const std::string& what = "",
+       SourceLocation location = SourceLocation::current()) {
+      return make_error(ErrorCode::UNKNOWN, what, location);
+    };
+constexpr auto Cancelled =
+    [](const std::string& what = "",
+       SourceLocation location = SourceLocation::current()) {
+      return make_error(ErrorCode::CANCELLED, what, location);
+    };
+constexpr auto InvalidArgument =
+    [](const std::string& what = "",
+       SourceLocation location = SourceLocation::current()) {
+      return make_error(ErrorCode::INVALID_ARGUMENT, what, location);
+    };
+constexpr auto Timeout =
+    [](const std::string& what = "",
+       SourceLocation location = SourceLocation::current()) {
+      return make_error(ErrorCode::TIMEOUT, what, location);
+    };
+constexpr auto NotFound =
+    [](const std::string& what = "",
+       SourceLocation location = SourceLocation::current()) {
+      return make_error(ErrorCode::NOT_FOUND, what, location);
+    };
+constexpr auto AlreadyExists =
+    [](const std::string& what = "",
+       SourceLocation location = SourceLocation::current()) {
+      return make_error(ErrorCode::ALREADY_EXISTS, what, location);
+    };
+constexpr auto PermissionDenied =
+    [](const std::string& what = "",
+       SourceLocation location = SourceLocation::current()) {
+      return make_error(ErrorCode::PERMISSION_DENIED, what, location);
+    };
+constexpr auto ResourceExhausted =
+    [](const std::string& what = "",
+       SourceLocation location = SourceLocation::current()) {
+      return make_error(ErrorCode::RESOURCE_EXHAUSTED, what, location);
+    };
+constexpr auto FailedPrecondition =
+    [](const std::string& what = "",
+       SourceLocation location = SourceLocation::current()) {
+      return make_error(ErrorCode::FAILED_PRECONDITION, what, location);
+    };
+constexpr auto Aborted =
+    [](const std::string& what = "",
+       SourceLocation location = SourceLocation::current()) {
+      return make_error(ErrorCode::ABORTED, what, location);
+    };
+constexpr auto OutOfRange =
+    [](const std::string& what = "",
+       SourceLocation location = SourceLocation::current()) {
+      return make_error(ErrorCode::OUT_OF_RANGE, what, location);
+    };
+constexpr auto Unimplemented =
+    [](const std::string& what = "",
+       SourceLocation location = SourceLocation::current()) {
+      return make_error(ErrorCode::UNIMPLEMENTED, what, location);
+    };
+constexpr auto Internal =
+    [](const std::string& what = "",
+       SourceLocation location = SourceLocation::current()) {
+      return make_error(ErrorCode::INTERNAL, what, location);
+    };
+constexpr auto Unavailable =
+    [](const std::string& what = "",
+       SourceLocation location = SourceLocation::current()) {
+      return make_error(ErrorCode::UNAVAILABLE, what, location);
+    };
+constexpr auto DataLoss =
+    [](const std::string& what = "",
+       SourceLocation location = SourceLocation::current()) {
+      return make_error(ErrorCode::DATA_LOSS, what, location);
+    };
+constexpr auto Unauthenticated =
+    [](const std::string& what = "",
+       SourceLocation location = SourceLocation::current()) {
+      return make_error(ErrorCode::UNAUTHENTICATED, what, location);
+    };
+constexpr auto Exception =
+    [](const std::string& what = "",
+       SourceLocation location = SourceLocation::current()) {
+      return make_error(ErrorCode::EXCEPTION, what, location);
+    };
+
+/**
+ * @brief      Add a frame of context to an error.  The frame comes from a
+ * thread local pool and the message is only formatted when the error is, so
+ * this does not allocate or format.
+ *
+ * @param[in]  error    The error
+ * @param[in]  context  The message, a format string literal, and its location
+ * @param[in]  args     Up to four arithmetic or string arguments, strings are
+ * copied and truncated to fit in the frame
+ *
+ * @tparam     String   The message type of the error
+ * @tparam     Args     The argument types
+ *
+ * @return     The error with the context added
+ */
+template <typename String, typename... Args>
+BasicError<String> with_context(BasicError<String> error,
+                                ContextMessage context, Args const&... args) {
+  static_assert(sizeof...(Args) <= ContextFrame::kMaxArgs,
+                "too many context arguments");
+  auto* frame = ContextPool::local().acquire();
+  frame->message = context.message;
+  frame->location = context.location;
+  (frame->push_arg(args), ...);
+  error.context.push(frame);
+  return error;
+}
+
+/**
+ * @brief      Make a function that adds context to an error, for use with
+ * map_error
+ *
+ * @param[in]  context  The message, a format string literal, and its location
+ * @param[in]  args     Up to four arithmetic or string arguments
+ *
+ * @tparam     Args     The argument types
+ *
+ * @return     A function taking and returning an Error
+ */
+template <typename... Args>
+auto add_context(ContextMessage context, Args... args) {
+  return [=](auto error) {
+    return with_context(std::move(error), context, args...);
+  };
+}
+
 /**
  * @brief      convert ErrorCode to string_view for easy formatting
  *
@@ -179,15 +429,26 @@ constexpr auto Exception = [](const std::string& what = "") {
 }
 
 /**
- * Result<T> type
+ * @brief      Unwraps std::reference_wrapper<T> to T&, like
+ * std::unwrap_reference from C++20
  *
- * @example    result.cpp
+ * @tparam     T     The type to unwrap
  */
-template <typename T, typename E = Error>
-using Result = tl::expected<T, E>;
+template <typename T>
+struct unwrap_reference {
+  using type = T;
+};
+template <typename T>
+struct unwrap_reference<std::reference_wrapper<T>> {
+  using type = T&;
+};
+template <typename T>
+using unwrap_reference_t = typename unwrap_reference<T>::type;
 
 /**
- * @brief      Makes a Result<T> from a T value
+ * @brief      Makes a Result<T> from a T value.  Use
+ * make_result(std::ref(value)) or make_result<T&>(value) to make a Result<T&>
+ * that borrows value.
  *
  * @param[in]  value  The value
  *
@@ -196,8 +457,18 @@ using Result = tl::expected<T, E>;
  * @return     A Result<T> containing value
  */
 template <typename T, typename E = Error>
-constexpr Result<T, E> make_result(T value) {
-  return Result<T, E>{value};
+constexpr Result<unwrap_reference_t<T>, E> make_result(T value) {
+  return Result<unwrap_reference_t<T>, E>{std::forward<T>(value)};
+}
+
+/**
+ * @brief      Makes a Result<void> with no error
+ *
+ * @return     A Result<void> with a value
+ */
+template <typename E = Error>
+constexpr Result<void, E> make_result() {
+  return Result<void, E>{};
 }
 
 /**
@@ -224,10 +495,11 @@ constexpr bool has_error(const tl::expected<T, E>& exp) {
  * @example     maybe_error.cpp
  */
 template <typename E, typename... Args>
-constexpr std::optional<E> maybe_error(tl::expected<Args, E>... args) {
+constexpr std::optional<E> maybe_error(
+    tl::expected<Args, E> const&... args) {
   auto maybe = std::optional<E>{std::nullopt};
   (
-      [&](auto& exp) {
+      [&](auto const& exp) {
         if (maybe.has_value()) return;
         if (has_error(exp)) maybe = exp.error();
       }(args),
@@ -235,60 +507,266 @@ constexpr std::optional<E> maybe_error(tl::expected<Args, E>... args) {
   return maybe;
 }
 
+namespace detail {
+
+template <typename R>
+using result_value_t = typename std::decay_t<R>::value_type;
+template <typename R>
+using result_error_t = typename std::decay_t<R>::error_type;
+
+template <typename R, typename... Rs>
+constexpr void check_zip_results() {
+  static_assert((std::is_same_v<result_error_t<R>, result_error_t<Rs>> && ...),
+                "all results must have the same error type");
+  static_assert(!(std::is_void_v<result_value_t<R>> ||
+                  (std::is_void_v<result_value_t<Rs>> || ...)),
+                "results must not be Result<void>");
+}
+
+/**
+ * @brief      The first error of results, moved out of rvalues.  Only called
+ * after one of them failed.
+ */
+template <typename E, typename... Rs>
+E first_error(Rs&&... results) {
+  auto error = std::optional<E>{};
+  (void)((results ? false
+                  : (error.emplace(std::forward<Rs>(results).error()), true)) ||
+         ...);
+  return *std::move(error);
+}
+
+/**
+ * @brief      Every error of results in argument order, moved out of rvalues
+ */
+template <typename E, typename... Rs>
+std::vector<E> all_errors(Rs&&... results) {
+  auto errors = std::vector<E>{};
+  errors.reserve(sizeof...(Rs));
+  ((results ? void() : errors.push_back(std::forward<Rs>(results).error())),
+   ...);
+  return errors;
+}
+
+template <typename E>
+struct ToErrors {
+  std::vector<E> operator()(E error) const {
+    auto errors = std::vector<E>{};
+    errors.push_back(std::move(error));
+    return errors;
+  }
+};
+
+}  // namespace detail
+
+/**
+ * @brief      Combine results into a Result of a tuple of their values.  The
+ * inputs are checked once and the values are moved out of rvalue results
+ * straight into the tuple.
+ *
+ * @param[in]  results  The results, all with the same error type
+ *
+ * @tparam     R        The first result type
+ * @tparam     Rs       The other result types
+ *
+ * @return     The tuple of the values, or the first error in argument order
+ */
+template <typename R, typename... Rs>
+auto zip(R&& result, Rs&&... results) {
+  detail::check_zip_results<R, Rs...>();
+  using Exp = Result<std::tuple<detail::result_value_t<R>,
+                                detail::result_value_t<Rs>...>,
+                     detail::result_error_t<R>>;
+  if (result && (results && ...)) {
+    return Exp{tl::in_place, *std::forward<R>(result),
+               *std::forward<Rs>(results)...};
+  }
+  return Exp{tl::make_unexpected(detail::first_error<detail::result_error_t<R>>(
+      std::forward<R>(result), std::forward<Rs>(results)...))};
+}
+
+/**
+ * @brief      Like zip, but with every error in argument order
+ *
+ * @return     The tuple of the values, or a vector of the errors
+ */
+template <typename R, typename... Rs>
+auto zip_all(R&& result, Rs&&... results) {
+  detail::check_zip_results<R, Rs...>();
+  using E = detail::result_error_t<R>;
+  using Exp = tl::expected<std::tuple<detail::result_value_t<R>,
+                                      detail::result_value_t<Rs>...>,
+                           std::vector<E>>;
+  if (result && (results && ...)) {
+    return Exp{tl::in_place, *std::forward<R>(result),
+               *std::forward<Rs>(results)...};
+  }
+  return Exp{tl::make_unexpected(detail::all_errors<E>(
+      std::forward<R>(result), std::forward<Rs>(results)...))};
+}
+
+/**
+ * @brief      Call f with the values of results if none failed.  The inputs
+ * are checked once and the values are moved out of rvalue results straight
+ * into f.  If f returns a Result it is returned as is, a void f gives a
+ * Result<void>.
+ *
+ * @param[in]  f        The function
+ * @param[in]  results  The results, all with the same error type
+ *
+ * @tparam     F        The function type
+ * @tparam     R        The first result type
+ * @tparam     Rs       The other result types
+ *
+ * @return     The return value of f as a Result, or the first error in
+ * argument order
+ */
+template <typename F, typename R, typename... Rs>
+auto apply(F&& f, R&& result, Rs&&... results) {
+  detail::check_zip_results<R, Rs...>();
+  using E = detail::result_error_t<R>;
+  using Ret = std::invoke_result_t<F, decltype(*std::forward<R>(result)),
+                                   decltype(*std::forward<Rs>(results))...>;
+  using Exp = detail::flatten_t<Ret, E>;
+  if (!(result && (results && ...))) {
+    return Exp{tl::make_unexpected(detail::first_error<E>(
+        std::forward<R>(result), std::forward<Rs>(results)...))};
+  }
+  if constexpr (std::is_void_v<Ret>) {
+    std::invoke(std::forward<F>(f), *std::forward<R>(result),
+                *std::forward<Rs>(results)...);
+    return Exp{};
+  } else {
+    return Exp{std::invoke(std::forward<F>(f), *std::forward<R>(result),
+                           *std::forward<Rs>(results)...)};
+  }
+}
+
+/**
+ * @brief      Like apply, but with every error of the inputs in argument order
+ *
+ * @return     The return value of f as a Result with a vector of errors
+ */
+template <typename F, typename R, typename... Rs>
+auto apply_all(F&& f, R&& result, Rs&&... results) {
+  detail::check_zip_results<R, Rs...>();
+  using E = detail::result_error_t<R>;
+  using Exp = decltype(fp::apply(std::forward<F>(f), std::forward<R>(result),
+                                 std::forward<Rs>(results)...)
+                           .map_error(detail::ToErrors<E>{}));
+  if (!(result && (results && ...))) {
+    return Exp{tl::make_unexpected(detail::all_errors<E>(
+        std::forward<R>(result), std::forward<Rs>(results)...))};
+  }
+  return fp::apply(std::forward<F>(f), std::forward<R>(result),
+                   std::forward<Rs>(results)...)
+      .map_error(detail::ToErrors<E>{});
+}
+
 /**
  * @brief      Try to Result<T>.  Lifts a function that throws an excpetpion to
- * one that returns a Result<T>
+ * one that returns a Result<T>.  A function returning void gives a
+ * Result<void>, one already returning a Result<T> is not nested.  If calling
+ * the function cannot throw there is no try/catch.
  *
- * @param[in]  f     The function to call
+ * @param[in]  f         The function to call
+ * @param[in]  location  Where the error is created, defaults to the caller
  *
- * @tparam     F     The function type
- * @tparam     Ret   The return value of the function
- * @tparam     Exp   The expected type
+ * @tparam     F         The function type
+ * @tparam     Ret       The return value of the function
+ * @tparam     Exp       The expected type
  *
  * @return     The return value of the function
  */
-template <typename F, typename Ret = typename std::result_of<F()>::type,
-          typename Exp = Result<Ret>>
-Exp try_to_result(F f) {
-  try {
-    return make_result(f());
-  } catch (const std::exception& ex) {
-    return tl::make_unexpected(Exception(fmt::format(
-        "[{}: {}]", abi::__cxa_current_exception_type()->name(), ex.what())));
+template <typename F, typename Ret = std::invoke_result_t<F&>,
+          typename Exp = detail::flatten_t<Ret, Error>>
+Exp try_to_result(F f, [[maybe_unused]] SourceLocation location =
+                           SourceLocation::current()) {
+  if constexpr (detail::is_nothrow_into_v<Exp, F>) {
+    return detail::invoke_into<Exp>(f);
+  } else {
+    try {
+      return detail::invoke_into<Exp>(f);
+    } catch (const std::exception& ex) {
+      return tl::make_unexpected(Exception(
+          fmt::format("[{}: {}]", abi::__cxa_current_exception_type()->name(),
+                      ex.what()),
+          location));
+    }
   }
 }
 
 }  // namespace fp
 
 /**
- * @brief      fmt format implementation for Error type
+ * @brief      fmt format implementation for Error type.  Context is written
+ * after the message, innermost first.  Use {:l} to also write where the error
+ * was created and where each frame of context was added, and {:b} to write the
+ * backtrace if one was captured.
  */
-template <>
-struct fmt::formatter<fp::Error> {
+template <typename String>
+struct fmt::formatter<fp::BasicError<String>> {
+  bool with_location = false;
+  bool with_backtrace = false;
+
   template <typename ParseContext>
   constexpr auto parse(ParseContext& ctx) {
-    return ctx.begin();
+    auto it = ctx.begin();
+    for (; it != ctx.end() && *it != '}'; ++it) {
+      if (*it == 'l') {
+        with_location = true;
+      } else if (*it == 'b') {
+        with_backtrace = true;
+      } else {
+        throw format_error("invalid format specifier for fp::Error");
+      }
+    }
+    return it;
   }
 
   template <typename FormatContext>
-  auto format(const fp::Error& error, FormatContext& ctx) {
-    return format_to(ctx.out(), "[Error: [{}] {}]", toStringView(error.code),
-                     error.what);
+  auto format(const fp::BasicError<String>& error, FormatContext& ctx) {
+    auto out = format_to(ctx.out(), "[Error: [{}", toStringView(error.code));
+    if (error.domain.info != nullptr) {
+      out = format_to(out, "/{}.{}", error.domain.info->name,
+                      error.domain.info->to_string(error.domain.value()));
+    }
+    out = format_to(out, "] {}", error.what);
+    if (with_location) out = fp::format_location(out, error.location);
+    out = format_frames(out, error.context.head());
+    if (with_backtrace && error.backtrace) {
+      auto* const format_backtrace =
+          fp::detail::backtrace_hooks.format.load(std::memory_order_acquire);
+      if (format_backtrace != nullptr) {
+        out = format_to(out, "{}", format_backtrace(*error.backtrace));
+      }
+    }
+    return format_to(out, "]");
+  }
+
+ private:
+  template <typename OutputIt>
+  OutputIt format_frames(OutputIt out, fp::ContextFrame const* frame) const {
+    if (frame == nullptr) return out;
+    out = format_frames(out, frame->next);
+    out = format_to(out, "; ");
+    return fp::format_frame(out, *frame, with_location);
   }
 };
 
 /**
  * @brief      fmt format implementation for Result<T> type
  */
-template <typename T>
-struct fmt::formatter<fp::Result<T>> {
+template <typename T, typename String>
+struct fmt::formatter<tl::expected<T, fp::BasicError<String>>> {
   template <typename ParseContext>
   constexpr auto parse(ParseContext& ctx) {
     return ctx.begin();
   }
 
   template <typename FormatContext>
-  auto format(const fp::Result<T>& result, FormatContext& ctx) {
+  auto format(const tl::expected<T, fp::BasicError<String>>& result,
+              FormatContext& ctx) {
     if (result.has_value()) {
       return format_to(ctx.out(), "[Result<T>: value={}]", result.value());
     } else {
@@ -296,3 +774,39 @@ struct fmt::formatter<fp::Result<T>> {
     }
   }
 };
+
+/**
+ * @brief      fmt format implementation for Result<void> type
+ */
+template <typename String>
+struct fmt::formatter<tl::expected<void, fp::BasicError<String>>> {
+  template <typename ParseContext>
+  constexpr auto parse(ParseContext& ctx) {
+    return ctx.begin();
+  }
+
+  template <typename FormatContext>
+  auto format(const tl::expected<void, fp::BasicError<String>>& result,
+              FormatContext& ctx) {
+    if (result.has_value()) {
+      return format_to(ctx.out(), "[Result<T>: void]");
+    } else {
+      return format_to(ctx.out(), "[Result<T>: {}]", result.error());
+    }
+  }
+};
+
+/**
+ * @brief      std::hash for Error, consistent with equality by hashing only the
+ * code and the message
+ */
+template <typename String>
+struct std::hash<fp::BasicError<String>> {
+  size_t operator()(fp::BasicError<String> const& error) const noexcept {
+    auto hash = fp::hash_message(std::string_view{error.what}) ^
+                (static_cast<uint64_t>(error.code) * 0x9E3779B97F4A7C15ULL) ^
+                (error.domain.bits * 0xD6E8FEB86659FD93ULL);
+    hash = (hash ^ (hash >> 29)) * 0xBF58476D1CE4E5B9ULL;
+    return static_cast<size_t>(hash ^ (hash >> 32));
+  }
+};
@@ -0,0 +1,134 @@
+// Copyright (c) 2022, Tyler Weaver
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <string>
+#include <type_traits>
+
+namespace tl {
+template <class T, class E>
+class expected;
+}  // namespace tl
+
+namespace fp {
+
+/**
+ * @brief      Enum for ErrorCodes inspired by absl::StatusCode, defined in
+ * fp/result.hpp
+ */
+enum class ErrorCode : int;
+
+template <typename String>
+struct BasicError;
+
+/**
+ * @brief      Error type used by Result<T>
+ */
+using Error = BasicError<std::string>;
+
+/**
+ * Result<T> type
+ *
+ * Declaring functions that take or return Result<T> only needs this header,
+ * which includes neither fmt nor range-v3.  Include fp/result.hpp to call them.
+ *
+ * @example    result.cpp
+ */
+template <typename T, typename E = Error>
+using Result = tl::expected<T, E>;
+
+/**
+ * @brief      Specialize to convert errors of type From to To when binding a
+ * function returning Result<U, To> to a Result<T, From>.  The specialization
+ * has a static To convert(From) and is only called on the error path.  Error
+ * types constructible from each other need no specialization.
+ *
+ * @tparam     From  The error type of the input
+ * @tparam     To    The error type of the function's result
+ */
+template <typename From, typename To, typename = void>
+struct ErrorConversion {};
+
+namespace detail {
+
+template <typename T>
+struct IsExpected : std::false_type {};
+template <typename T, typename E>
+struct IsExpected<tl::expected<T, E>> : std::true_type {};
+
+/**
+ * @brief      tl::expected<Ret, E>, or Ret if it already is a
+ * tl::expected<T, E> so lifting a function returning one does not nest it
+ */
+template <typename Ret, typename E>
+struct Flatten {
+  using type = tl::expected<Ret, E>;
+};
+template <typename T, typename E>
+struct Flatten<tl::expected<T, E>, E> {
+  using type = tl::expected<T, E>;
+};
+template <typename Ret, typename E>
+using flatten_t = typename Flatten<Ret, E>::type;
+
+template <typename Exp, typename Ret>
+constexpr bool is_nothrow_wrap() {
+  if constexpr (std::is_void_v<Ret> || std::is_same_v<Ret, Exp>) {
+    return true;
+  } else {
+    return std::is_nothrow_constructible_v<typename Exp::value_type, Ret>;
+  }
+}
+
+/**
+ * @brief      True if calling F and making an Exp from what it returns cannot
+ * throw, so lifting it needs no try/catch.  tl::expected does not mark its
+ * constructors noexcept, so this checks the value type's constructor.
+ */
+template <typename Exp, typename F, typename Ret = std::invoke_result_t<F&>>
+constexpr bool is_nothrow_into_v =
+    std::is_nothrow_invocable_v<F&> && is_nothrow_wrap<Exp, Ret>();
+
+/**
+ * @brief      Call f and make an Exp from what it returns, which is a move if
+ * f already returns an Exp
+ */
+template <typename Exp, typename F>
+Exp invoke_into(F& f) {
+  if constexpr (std::is_void_v<std::invoke_result_t<F&>>) {
+    f();
+    return Exp{};
+  } else {
+    return Exp{f()};
+  }
+}
+
+}  // namespace detail
+
+}  // namespace fp
@@ -0,0 +1,430 @@
+// Copyright (c) 2022, Tyler Weaver
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#pragma once
+
+#include <fmt/format.h>
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+#include "fp/result.hpp"
+
+/**
+ * Compact binary encoding of Error and Result<T> for IPC and logging.
+ *
+ * Every top level message starts with the version byte kSerializeVersion.
+ * Integers are encoded as LEB128 varints.
+ *
+ *   Error:     version, code (varint), size (varint), size message bytes
+ *   Result<T>: version, 0, value  or  version, 1, code, size, message
+ *
+ * Domain codes are not encoded, a decoded error keeps the canonical code.
+ *
+ * Trivially copyable values are stored as their native (little endian on
+ * every supported platform) object representation, std::string is stored as
+ * size and bytes.  Other types can be made serializable by specializing
+ * fp::serializer<T>.
+ *
+ * Writing goes to a sink, any callable taking a std::string_view, so a message
+ * can be streamed into a file, socket or buffer without an intermediate copy.
+ * Reading is from a std::string_view, such as a memory mapped file, and
+ * ErrorView refers to the message in the buffer without copying it.
+ */
+namespace fp {
+
+constexpr uint8_t kSerializeVersion = 1;
+
+/**
+ * @brief      Number of bytes used to encode value as a varint
+ */
+constexpr size_t varint_size(uint64_t value) noexcept {
+  size_t size = 1;
+  while (value >= 0x80) {
+    value >>= 7;
+    ++size;
+  }
+  return size;
+}
+
+/**
+ * @brief      Write value as a LEB128 varint to a sink
+ *
+ * @param[in]  sink   The sink, called with a std::string_view
+ * @param[in]  value  The value
+ */
+template <typename Sink>
+void write_varint(Sink&& sink, uint64_t value) {
+  char bytes[10];
+  size_t size = 0;
+  while (value >= 0x80) {
+    bytes[size++] = static_cast<char>((value & 0x7f) | 0x80);
+    value >>= 7;
+  }
+  bytes[size++] = static_cast<char>(value);
+  sink(std::string_view{bytes, size});
+}
+
+/**
+ * @brief      Reads encoded values from a buffer without copying it
+ */
+class Reader {
+  std::string_view data_;
+  size_t offset_ = 0;
+
+ public:
+  explicit constexpr Reader(std::string_view data) noexcept : data_(data) {}
+
+  /**
+   * @brief      Number of bytes read so far
+   */
+  constexpr size_t offset() const noexcept { return offset_; }
+
+  /**
+   * @brief      The bytes that have not been read yet
+   */
+  constexpr std::string_view remaining() const noexcept {
+    return data_.substr(offset_);
+  }
+
+  /**
+   * @brief      Read size bytes
+   *
+   * @return     A view of the bytes in the buffer or DataLoss if truncated
+   */
+  Result<std::string_view> bytes(size_t size) {
+    if (size > data_.size() - offset_) {
+      return tl::make_unexpected(DataLoss(fmt::format(
+          "truncated at byte {}: need {} more bytes, have {}", offset_, size,
+          data_.size() - offset_)));
+    }
+    auto const view = data_.substr(offset_, size);
+    offset_ += size;
+    return view;
+  }
+
+  /**
+   * @brief      Read a LEB128 varint
+   *
+   * @return     The value or DataLoss if it is truncated, too long or does
+   * not fit in 64 bits
+   */
+  Result<uint64_t> varint() {
+    uint64_t value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+      if (offset_ == data_.size()) {
+        return tl::make_unexpected(
+            DataLoss(fmt::format("truncated varint at byte {}", offset_)));
+      }
+      auto const byte = static_cast<uint8_t>(data_[offset_++]);
+      // the 10th byte holds only the top bit
+      if (shift == 63 && (byte & 0x7f) > 1) {
+        return tl::make_unexpected(DataLoss(
+            fmt::format("varint overflows 64 bits at byte {}", offset_ - 1)));
+      }
+      value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+      if ((byte & 0x80) == 0) return value;
+    }
+    return tl::make_unexpected(
+        DataLoss(fmt::format("varint longer than 10 bytes at {}", offset_)));
+  }
+
+  /**
+   * @brief      Read and check the version byte
+   *
+   * @return     DataLoss if the version is not kSerializeVersion
+   */
+  Result<void> version() {
+    auto const byte = bytes(1);
+    if (!byte) return tl::make_unexpected(byte.error());
+    auto const version = static_cast<uint8_t>(byte.value()[0]);
+    if (version != kSerializeVersion) {
+      return tl::make_unexpected(DataLoss(fmt::format(
+          "unsupported version {}, expected {}", version, kSerializeVersion)));
+    }
+    return {};
+  }
+};
+
+/**
+ * @brief      Customization point for serializing values of type T in a
+ * Result<T>.  Specializations provide:
+ *
+ *   static size_t size(T const& value);
+ *   template <typename Sink> static void write(Sink&& sink, T const& value);
+ *   static Result<T> read(Reader& reader);
+ *
+ * @tparam     T     The value type
+ */
+template <typename T, typename = void>
+struct serializer;
+
+/**
+ * @brief      Serializer for trivially copyable types, stored as their object
+ * representation
+ */
+template <typename T>
+struct serializer<T, std::enable_if_t<std::is_trivially_copyable_v<T> &&
+                                      std::is_default_constructible_v<T>>> {
+  static constexpr size_t size(T const&) noexcept { return sizeof(T); }
+
+  template <typename Sink>
+  static void write(Sink&& sink, T const& value) {
+    sink(std::string_view{reinterpret_cast<char const*>(&value), sizeof(T)});
+  }
+
+  static Result<T> read(Reader& reader) {
+    auto const bytes = reader.bytes(sizeof(T));
+    if (!bytes) return tl::make_unexpected(bytes.error());
+    T value;
+    std::memcpy(&value, bytes.value().data(), sizeof(T));
+    return value;
+  }
+};
+
+/**
+ * @brief      Serializer for std::string, stored as size and bytes
+ */
+template <>
+struct serializer<std::string> {
+  static size_t size(std::string const& value) noexcept {
+    return varint_size(value.size()) + value.size();
+  }
+
+  template <typename Sink>
+  static void write(Sink&& sink, std::string const& value) {
+    write_varint(sink, value.size());
+    sink(std::string_view{value});
+  }
+
+  static Result<std::string> read(Reader& reader) {
+    auto const size = reader.varint();
+    if (!size) return tl::make_unexpected(size.error());
+    auto const bytes = reader.bytes(size.value());
+    if (!bytes) return tl::make_unexpected(bytes.error());
+    return std::string{bytes.value()};
+  }
+};
+
+/**
+ * @brief      An Error read from a buffer, what refers to the buffer
+ */
+struct ErrorView {
+  ErrorCode code = ErrorCode::UNKNOWN;
+  std::string_view what = "";
+
+  /**
+   * @brief      Copy the message into an Error
+   */
+  Error to_error() const { return Error{code, std::string{what}}; }
+};
+
+/**
+ * @brief      Size of an Error body (code, size and message)
+ */
+inline size_t serialized_body_size(Error const& error) noexcept {
+  return varint_size(static_cast<uint64_t>(error.code)) +
+         varint_size(error.what.size()) + error.what.size();
+}
+
+/**
+ * @brief      Write an Error body (code, size and message) to a sink
+ */
+template <typename Sink>
+void serialize_body(Sink&& sink, Error const& error) {
+  write_varint(sink, static_cast<uint64_t>(error.code));
+  write_varint(sink, error.what.size());
+  sink(std::string_view{error.what});
+}
+
+/**
+ * @brief      Read an Error body (code, size and message) without copying the
+ * message
+ */
+inline Result<ErrorView> deserialize_body(Reader& reader) {
+  auto const code = reader.varint();
+  if (!code) return tl::make_unexpected(code.error());
+  if (code.value() > static_cast<uint64_t>(ErrorCode::EXCEPTION)) {
+    return tl::make_unexpected(
+        DataLoss(fmt::format("invalid error code {}", code.value())));
+  }
+  auto const size = reader.varint();
+  if (!size) return tl::make_unexpected(size.error());
+  auto const what = reader.bytes(size.value());
+  if (!what) return tl::make_unexpected(what.error());
+  return ErrorView{static_cast<ErrorCode>(code.value()), what.value()};
+}
+
+/**
+ * @brief      Number of bytes serialize writes for an Error
+ */
+inline size_t serialized_size(Error const& error) noexcept {
+  return 1 + serialized_body_size(error);
+}
+
+/**
+ * @brief      Write an Error to a sink
+ *
+ * @param[in]  sink   The sink, called with each std::string_view to write
+ * @param[in]  error  The error
+ */
+template <typename Sink>
+void serialize(Sink&& sink, Error const& error) {
+  char const version = static_cast<char>(kSerializeVersion);
+  sink(std::string_view{&version, 1});
+  serialize_body(sink, error);
+}
+
+/**
+ * @brief      Number of bytes serialize writes for a Result<T>
+ */
+template <typename T>
+size_t serialized_size(Result<T> const& result) {
+  if (!result) return 2 + serialized_body_size(result.error());
+  if constexpr (std::is_void_v<T>) {
+    return 2;
+  } else {
+    return 2 + serializer<T>::size(result.value());
+  }
+}
+
+/**
+ * @brief      Write a Result<T> to a sink
+ *
+ * @param[in]  sink    The sink, called with each std::string_view to write
+ * @param[in]  result  The result
+ */
+template <typename T, typename Sink>
+void serialize(Sink&& sink, Result<T> const& result) {
+  char const header[] = {static_cast<char>(kSerializeVersion),
+                         static_cast<char>(result ? 0 : 1)};
+  sink(std::string_view{header, 2});
+  if (!result) {
+    serialize_body(sink, result.error());
+  } else if constexpr (!std::is_void_v<T>) {
+    serializer<T>::write(sink, result.value());
+  }
+}
+
+/**
+ * @brief      Write an Error or Result<T> into a buffer, for example shared
+ * memory, without allocating
+ *
+ * @param[in]  value  The Error or Result<T>
+ * @param[in]  data   The buffer
+ * @param[in]  size   The size of the buffer
+ *
+ * @return     The number of bytes written or ResourceExhausted if the buffer
+ * is too small
+ */
+template <typename V>
+Result<size_t> serialize_to(V const& value, char* data, size_t size) {
+  auto const required = serialized_size(value);
+  if (required > size) {
+    return tl::make_unexpected(ResourceExhausted(fmt::format(
+        "buffer of {} bytes is too small, need {}", size, required)));
+  }
+  size_t offset = 0;
+  serialize(
+      [&](std::string_view bytes) {
+        std::memcpy(data + offset, bytes.data(), bytes.size());
+        offset += bytes.size();
+      },
+      value);
+  return offset;
+}
+
+/**
+ * @brief      Read an Error from a buffer without copying the message
+ *
+ * @param[in]  reader  The reader of the buffer
+ *
+ * @return     A view of the error or DataLoss if the encoding is invalid
+ */
+inline Result<ErrorView> deserialize_error_view(Reader& reader) {
+  auto const version = reader.version();
+  if (!version) return tl::make_unexpected(version.error());
+  return deserialize_body(reader);
+}
+
+/**
+ * @brief      Read an Error from a buffer
+ *
+ * @param[in]  reader  The reader of the buffer
+ *
+ * @return     The error or DataLoss if the encoding is invalid
+ */
+inline Result<Error> deserialize_error(Reader& reader) {
+  auto const view = deserialize_error_view(reader);
+  if (!view) return tl::make_unexpected(view.error());
+  return view.value().to_error();
+}
+
+/**
+ * @brief      Read a Result<T> from a buffer.  The outer Result has an error
+ * if the encoding is invalid, the inner one is the Result that was written.
+ *
+ * @param[in]  reader  The reader of the buffer
+ *
+ * @tparam     T       The value type
+ *
+ * @return     The result or DataLoss if the encoding is invalid
+ */
+template <typename T>
+Result<Result<T>> deserialize_result(Reader& reader) {
+  auto const version = reader.version();
+  if (!version) return tl::make_unexpected(version.error());
+  auto const tag = reader.bytes(1);
+  if (!tag) return tl::make_unexpected(tag.error());
+  switch (tag.value()[0]) {
+    case 0:
+      if constexpr (std::is_void_v<T>) {
+        return Result<Result<T>>{tl::in_place};
+      } else {
+        auto value = serializer<T>::read(reader);
+        if (!value) return tl::make_unexpected(value.error());
+        return Result<Result<T>>{tl::in_place, std::move(value).value()};
+      }
+    case 1: {
+      auto const error = deserialize_body(reader);
+      if (!error) return tl::make_unexpected(error.error());
+      return Result<Result<T>>{tl::in_place,
+                               tl::make_unexpected(error.value().to_error())};
+    }
+    default:
+      return tl::make_unexpected(DataLoss(fmt::format(
+          "invalid result tag {}", static_cast<int>(tag.value()[0]))));
+  }
+}
+
+}  // namespace fp
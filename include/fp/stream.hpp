@@ -0,0 +1,327 @@
+// Copyright (c) 2022, Tyler Weaver
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <fcntl.h>
+#include <fmt/format.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <iterator>
+#include <limits>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "fp/parallel.hpp"
+#include "fp/result.hpp"
+#include "fp/thread_pool.hpp"
+
+namespace fp::stream {
+
+/**
+ * @brief      Options for splitting and parsing records
+ */
+struct Options {
+  char delimiter = '\n';
+  /// Skip records that are empty, such as blank lines
+  bool skip_empty = true;
+  /// Approximate size of the chunks parsed in parallel, chunks are extended
+  /// to end on a delimiter
+  size_t chunk_size = size_t{1} << 20;
+  ThreadPool* pool = &ThreadPool::instance();
+};
+
+/**
+ * @brief      Position of a record in its input
+ */
+struct RecordLocation {
+  size_t offset = 0;  ///< Byte offset of the first character
+  size_t line = 1;    ///< One based record number
+};
+
+/**
+ * @brief      Read only memory mapping of a file
+ */
+class MappedFile {
+  void* data_ = nullptr;
+  size_t size_ = 0;
+
+  MappedFile(void* data, size_t size) : data_(data), size_(size) {}
+
+ public:
+  MappedFile() = default;
+  MappedFile(MappedFile const&) = delete;
+  MappedFile& operator=(MappedFile const&) = delete;
+  MappedFile(MappedFile&& other) noexcept
+      : data_(std::exchange(other.data_, nullptr)),
+        size_(std::exchange(other.size_, 0)) {}
+  MappedFile& operator=(MappedFile&& other) noexcept {
+    std::swap(data_, other.data_);
+    std::swap(size_, other.size_);
+    return *this;
+  }
+  ~MappedFile() {
+    if (data_ != nullptr) ::munmap(data_, size_);
+  }
+
+  /**
+   * @brief      Map a file into memory
+   *
+   * @param[in]  path  The path to the file
+   *
+   * @return     The mapping, NotFound if the file does not exist or
+   * Unavailable if it could not be mapped
+   */
+  static Result<MappedFile> open(std::string const& path) {
+    auto const fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+      auto const error = errno;
+      auto const what =
+          fmt::format("could not open {}: {}", path, std::strerror(error));
+      return tl::make_unexpected(error == ENOENT ? NotFound(what)
+                                                 : Unavailable(what));
+    }
+    struct stat status {};
+    if (::fstat(fd, &status) != 0) {
+      auto const error = errno;
+      auto const what =
+          fmt::format("could not stat {}: {}", path, std::strerror(error));
+      ::close(fd);
+      return tl::make_unexpected(Unavailable(what));
+    }
+    auto const size = static_cast<size_t>(status.st_size);
+    if (size == 0) {
+      ::close(fd);
+      return MappedFile{};
+    }
+    auto* const data = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    auto const error = errno;
+    ::close(fd);
+    if (data == MAP_FAILED) {
+      return tl::make_unexpected(Unavailable(
+          fmt::format("could not map {}: {}", path, std::strerror(error))));
+    }
+    ::madvise(data, size, MADV_SEQUENTIAL);
+    return MappedFile{data, size};
+  }
+
+  std::string_view data() const {
+    return {static_cast<char const*>(data_), size_};
+  }
+  size_t size() const { return size_; }
+};
+
+/**
+ * @brief      Call f with each record of data and its location, without
+ * copying.  A carriage return before a newline delimiter is not part of the
+ * record.
+ *
+ * @param[in]  data     The records
+ * @param[in]  f        Called with (std::string_view, RecordLocation),
+ * returning false stops
+ * @param[in]  options  The delimiter and if empty records are skipped
+ *
+ * @return     The number of delimiters passed
+ */
+template <typename F>
+size_t for_each_record(std::string_view data, F&& f,
+                       Options const& options = {}) {
+  auto const* const first = data.data();
+  auto const* const last = first + data.size();
+  auto location = RecordLocation{};
+  auto delimiters = size_t{0};
+  for (auto const* begin = first; begin < last;) {
+    auto const* delimiter = static_cast<char const*>(
+        std::memchr(begin, options.delimiter, last - begin));
+    auto const* end = delimiter != nullptr ? delimiter : last;
+    auto record = std::string_view(begin, end - begin);
+    if (options.delimiter == '\n' && !record.empty() && record.back() == '\r') {
+      record.remove_suffix(1);
+    }
+    location.offset = begin - first;
+    if (!(options.skip_empty && record.empty()) && !f(record, location)) {
+      break;
+    }
+    if (delimiter == nullptr) break;
+    ++delimiters;
+    ++location.line;
+    begin = delimiter + 1;
+  }
+  return delimiters;
+}
+
+namespace detail {
+
+/**
+ * @brief      Offsets where chunks of about chunk_size start, each after a
+ * delimiter, followed by the size of data
+ */
+inline std::vector<size_t> chunk_bounds(std::string_view data,
+                                        Options const& options) {
+  auto bounds = std::vector<size_t>{0};
+  auto const chunk_size = std::max<size_t>(options.chunk_size, 1);
+  while (data.size() - bounds.back() > chunk_size) {
+    auto const delimiter =
+        data.find(options.delimiter, bounds.back() + chunk_size - 1);
+    if (delimiter == std::string_view::npos) break;
+    bounds.push_back(delimiter + 1);
+  }
+  if (bounds.back() != data.size()) bounds.push_back(data.size());
+  return bounds;
+}
+
+template <typename T>
+struct ParsedChunk {
+  std::vector<T> values;
+  size_t delimiters = 0;
+  std::optional<Error> error;
+  RecordLocation location;
+};
+
+}  // namespace detail
+
+/**
+ * @brief      Parse each record of data with a pipeline returning Result<T>.
+ * The data is split into chunks on record boundaries which are parsed in
+ * parallel on the thread pool.  Records are passed as views into data.
+ *
+ * @param[in]  data     The records
+ * @param[in]  parse    Called with each record as a std::string_view,
+ * returning Result<T>; called concurrently
+ * @param[in]  options  The delimiter, chunk size and thread pool
+ *
+ * @return     The values in the order of the records, or the error of the
+ * first record that failed with its byte offset and line added as context
+ */
+template <typename F,
+          typename T =
+              typename std::invoke_result_t<F const&, std::string_view>::
+                  value_type>
+Result<std::vector<T>> parse_records(std::string_view data, F const& parse,
+                                     Options const& options = {}) {
+  auto const bounds = detail::chunk_bounds(data, options);
+  auto const chunks = bounds.size() - 1;
+  auto parsed = std::vector<detail::ParsedChunk<T>>(chunks);
+  auto first_error = std::atomic<size_t>{std::numeric_limits<size_t>::max()};
+
+  auto const run_chunk = [&](size_t index) {
+    auto& chunk = parsed[index];
+    auto const begin = bounds[index];
+    auto const on_record = [&](std::string_view record,
+                               RecordLocation location) {
+      location.offset += begin;
+      if (location.offset > first_error.load(std::memory_order_relaxed)) {
+        return false;
+      }
+      auto const call = [&] { return parse(record); };
+      auto result = invoke_to_result(call);
+      if (result) {
+        chunk.values.push_back(std::move(result).value());
+        return true;
+      }
+      chunk.error = std::move(result).error();
+      chunk.location = location;
+      auto expected = first_error.load(std::memory_order_relaxed);
+      while (location.offset < expected &&
+             !first_error.compare_exchange_weak(expected, location.offset)) {
+      }
+      return false;
+    };
+    chunk.delimiters = for_each_record(
+        data.substr(begin, bounds[index + 1] - begin), on_record, options);
+  };
+
+  if (chunks > 1) {
+    auto group = TaskGroup{*options.pool};
+    for (size_t index = 1; index < chunks; ++index) {
+      group.run([&run_chunk, index] { run_chunk(index); });
+    }
+    run_chunk(0);
+    group.wait();
+  } else if (chunks == 1) {
+    run_chunk(0);
+  }
+
+  // Chunks before the first error always run to completion so their line
+  // counts are exact.
+  auto lines = size_t{0};
+  auto total = size_t{0};
+  for (auto& chunk : parsed) {
+    if (chunk.error) {
+      return tl::make_unexpected(
+          with_context(std::move(chunk.error).value(),
+                       "record at byte {} line {}", chunk.location.offset,
+                       lines + chunk.location.line));
+    }
+    lines += chunk.delimiters;
+    total += chunk.values.size();
+  }
+
+  auto values = std::vector<T>{};
+  values.reserve(total);
+  for (auto& chunk : parsed) {
+    std::move(chunk.values.begin(), chunk.values.end(),
+              std::back_inserter(values));
+  }
+  return values;
+}
+
+/**
+ * @brief      Memory map a file and parse its records with parse_records.
+ * The mapping is released before returning so T must not refer to the
+ * records.
+ *
+ * @param[in]  path     The path to the file
+ * @param[in]  parse    Called with each record, returning Result<T>
+ * @param[in]  options  The delimiter, chunk size and thread pool
+ *
+ * @return     The values or the first error
+ */
+template <typename F,
+          typename T =
+              typename std::invoke_result_t<F const&, std::string_view>::
+                  value_type>
+Result<std::vector<T>> parse_file(std::string const& path, F const& parse,
+                                  Options const& options = {}) {
+  return MappedFile::open(path).and_then([&](MappedFile const& file) {
+    return parse_records(file.data(), parse, options);
+  });
+}
+
+}  // namespace fp::stream
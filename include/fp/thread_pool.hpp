@@ -0,0 +1,196 @@
+// Copyright (c) 2022, Tyler Weaver
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace fp {
+
+/**
+ * @brief      Fixed size pool of worker threads sharing a task queue
+ */
+class ThreadPool {
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::deque<std::function<void()>> tasks_;
+  bool stop_ = false;
+  std::vector<std::thread> workers_;
+
+ public:
+  /**
+   * @brief      Start the worker threads
+   *
+   * @param[in]  threads  Number of worker threads, defaults to the number of
+   * hardware threads
+   */
+  explicit ThreadPool(
+      size_t threads = std::max(1u, std::thread::hardware_concurrency())) {
+    workers_.reserve(threads);
+    for (size_t i = 0; i < threads; ++i) {
+      workers_.emplace_back([this] { work(); });
+    }
+  }
+
+  ThreadPool(ThreadPool const&) = delete;
+  ThreadPool& operator=(ThreadPool const&) = delete;
+
+  /**
+   * @brief      Finish the queued tasks and join the worker threads
+   */
+  ~ThreadPool() {
+    {
+      auto const lock = std::lock_guard{mutex_};
+      stop_ = true;
+    }
+    cv_.notify_all();
+    for (auto& worker : workers_) worker.join();
+  }
+
+  /**
+   * @brief      The shared pool used by default
+   */
+  static ThreadPool& instance() {
+    static auto pool = ThreadPool{};
+    return pool;
+  }
+
+  /**
+   * @brief      Number of worker threads
+   */
+  size_t size() const noexcept { return workers_.size(); }
+
+  /**
+   * @brief      Queue a task to run on a worker thread
+   */
+  void submit(std::function<void()> task) {
+    {
+      auto const lock = std::lock_guard{mutex_};
+      tasks_.push_back(std::move(task));
+    }
+    cv_.notify_one();
+  }
+
+  /**
+   * @brief      Run one queued task on the calling thread, used to help while
+   * waiting so tasks that wait on other tasks cannot deadlock the pool
+   *
+   * @return     If a task was run
+   */
+  bool try_run_one() {
+    auto task = std::function<void()>{};
+    {
+      auto const lock = std::lock_guard{mutex_};
+      if (tasks_.empty()) return false;
+      task = std::move(tasks_.front());
+      tasks_.pop_front();
+    }
+    task();
+    return true;
+  }
+
+ private:
+  void work() {
+    while (true) {
+      auto task = std::function<void()>{};
+      {
+        auto lock = std::unique_lock{mutex_};
+        cv_.wait(lock, [this] { return stop_ || !tasks_.empty(); });
+        if (tasks_.empty()) return;
+        task = std::move(tasks_.front());
+        tasks_.pop_front();
+      }
+      task();
+    }
+  }
+};
+
+/**
+ * @brief      A group of tasks run on a ThreadPool that can be waited on.  The
+ * waiting thread runs queued tasks while it waits.
+ */
+class TaskGroup {
+  ThreadPool& pool_;
+  std::atomic<size_t> pending_{0};
+  std::mutex mutex_;
+  std::condition_variable cv_;
+
+ public:
+  explicit TaskGroup(ThreadPool& pool = ThreadPool::instance()) : pool_(pool) {}
+
+  TaskGroup(TaskGroup const&) = delete;
+  TaskGroup& operator=(TaskGroup const&) = delete;
+
+  ~TaskGroup() { wait(); }
+
+  /**
+   * @brief      Run a task on the pool as part of this group
+   *
+   * @param[in]  task  The task, must not throw
+   */
+  template <typename F>
+  void run(F task) {
+    pending_.fetch_add(1, std::memory_order_relaxed);
+    pool_.submit([this, task = std::move(task)]() mutable {
+      task();
+      auto const lock = std::lock_guard{mutex_};
+      if (pending_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        cv_.notify_all();
+      }
+    });
+  }
+
+  /**
+   * @brief      Wait for all the tasks of this group to finish
+   */
+  void wait() {
+    while (pending_.load(std::memory_order_acquire) != 0) {
+      if (pool_.try_run_one()) continue;
+      auto lock = std::unique_lock{mutex_};
+      cv_.wait_for(lock, std::chrono::microseconds{100}, [this] {
+        return pending_.load(std::memory_order_acquire) == 0;
+      });
+    }
+    // the last task notifies while holding the mutex, wait for it to release
+    // it so the group can be destroyed
+    auto const lock = std::lock_guard{mutex_};
+  }
+};
+
+}  // namespace fp
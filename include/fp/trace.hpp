@@ -0,0 +1,375 @@
+// Copyright (c) 2022, Tyler Weaver
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#pragma once
+
+#include <cxxabi.h>
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <typeinfo>
+#include <utility>
+#include <vector>
+
+#include "fp/result.hpp"
+#include "fp/write_file.hpp"
+
+/**
+ * Number of records kept per thread, must be a power of two.  When the ring
+ * buffer is full the oldest records are overwritten.
+ */
+#ifndef FP_TRACE_CAPACITY
+#define FP_TRACE_CAPACITY 4096
+#endif
+
+namespace fp::trace {
+
+static_assert((FP_TRACE_CAPACITY & (FP_TRACE_CAPACITY - 1)) == 0,
+              "FP_TRACE_CAPACITY must be a power of two");
+
+/**
+ * @brief      A traced pipeline stage
+ */
+struct Record {
+  char const* name = nullptr;  ///< static string, the type name or a name
+  bool mangled = false;        ///< if name is a mangled type name
+  bool ok = false;             ///< if the stage returned a value
+  int64_t begin_ns = 0;        ///< steady_clock time on entry
+  int64_t end_ns = 0;          ///< steady_clock time on exit
+};
+
+/**
+ * @brief      Per-thread single producer ring buffer of Records.  Each slot is
+ * a seqlock so export can read it while the owning thread keeps writing
+ * without locks on the hot path.
+ */
+class RingBuffer {
+  struct Slot {
+    std::atomic<uint64_t> seq{0};
+    std::atomic<char const*> name{nullptr};
+    std::atomic<bool> mangled{false};
+    std::atomic<bool> ok{false};
+    std::atomic<int64_t> begin_ns{0};
+    std::atomic<int64_t> end_ns{0};
+  };
+
+  std::unique_ptr<Slot[]> slots_ = std::make_unique<Slot[]>(FP_TRACE_CAPACITY);
+  std::atomic<uint64_t> head_{0};
+  std::atomic<uint64_t> tail_{0};
+
+ public:
+  /// Id of the buffer, threads that reuse it share the id
+  int const tid;
+
+  explicit RingBuffer(int id) : tid(id) {}
+
+  void push(Record const& record) noexcept {
+    auto const index = head_.load(std::memory_order_relaxed);
+    auto& slot = slots_[index & (FP_TRACE_CAPACITY - 1)];
+    slot.seq.store(2 * index + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.name.store(record.name, std::memory_order_relaxed);
+    slot.mangled.store(record.mangled, std::memory_order_relaxed);
+    slot.ok.store(record.ok, std::memory_order_relaxed);
+    slot.begin_ns.store(record.begin_ns, std::memory_order_relaxed);
+    slot.end_ns.store(record.end_ns, std::memory_order_relaxed);
+    slot.seq.store(2 * index + 2, std::memory_order_release);
+    head_.store(index + 1, std::memory_order_release);
+  }
+
+  /**
+   * @brief      Copy out the records that are currently in the buffer, oldest
+   * first.  Records overwritten while reading are skipped.
+   */
+  std::vector<Record> snapshot() const {
+    auto const head = head_.load(std::memory_order_acquire);
+    auto index = std::max(tail_.load(std::memory_order_relaxed),
+                          head > FP_TRACE_CAPACITY ? head - FP_TRACE_CAPACITY
+                                                   : uint64_t{0});
+    auto records = std::vector<Record>{};
+    records.reserve(head - index);
+    for (; index < head; ++index) {
+      auto const& slot = slots_[index & (FP_TRACE_CAPACITY - 1)];
+      auto const seq = slot.seq.load(std::memory_order_acquire);
+      auto const record =
+          Record{slot.name.load(std::memory_order_relaxed),
+                 slot.mangled.load(std::memory_order_relaxed),
+                 slot.ok.load(std::memory_order_relaxed),
+                 slot.begin_ns.load(std::memory_order_relaxed),
+                 slot.end_ns.load(std::memory_order_relaxed)};
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (seq == 2 * index + 2 &&
+          slot.seq.load(std::memory_order_relaxed) == seq) {
+        records.push_back(record);
+      }
+    }
+    return records;
+  }
+
+  /**
+   * @brief      Drop the records currently in the buffer
+   */
+  void clear() noexcept {
+    tail_.store(head_.load(std::memory_order_acquire),
+                std::memory_order_relaxed);
+  }
+};
+
+/**
+ * @brief      Registry of the ring buffers of threads tracing stages.  When a
+ * thread exits its buffer and records are kept for export, and the next
+ * thread that starts tracing appends to it under the same tid.  So there are
+ * at most as many buffers as threads that traced at the same time, and
+ * threads sharing a tid never overlapped.  The mutex is only taken when a
+ * thread starts or exits and when exporting.
+ */
+class Registry {
+  std::mutex mutex_;
+  std::vector<std::shared_ptr<RingBuffer>> buffers_;
+  std::vector<std::shared_ptr<RingBuffer>> free_;
+
+ public:
+  static Registry& instance() {
+    static auto registry = Registry{};
+    return registry;
+  }
+
+  std::shared_ptr<RingBuffer> acquire() {
+    auto const lock = std::lock_guard{mutex_};
+    if (!free_.empty()) {
+      auto buffer = std::move(free_.back());
+      free_.pop_back();
+      return buffer;
+    }
+    return buffers_.emplace_back(
+        std::make_shared<RingBuffer>(static_cast<int>(buffers_.size())));
+  }
+
+  void release(std::shared_ptr<RingBuffer> buffer) {
+    auto const lock = std::lock_guard{mutex_};
+    free_.push_back(std::move(buffer));
+  }
+
+  std::vector<std::shared_ptr<RingBuffer>> buffers() {
+    auto const lock = std::lock_guard{mutex_};
+    return buffers_;
+  }
+};
+
+/**
+ * @brief      Owns the ring buffer of a thread and returns it to the registry
+ * when the thread exits
+ */
+struct ThreadBuffer {
+  std::shared_ptr<RingBuffer> buffer = Registry::instance().acquire();
+
+  ThreadBuffer() = default;
+  ThreadBuffer(ThreadBuffer const&) = delete;
+  ThreadBuffer& operator=(ThreadBuffer const&) = delete;
+  ~ThreadBuffer() { Registry::instance().release(std::move(buffer)); }
+};
+
+/**
+ * @brief      The ring buffer of the calling thread
+ */
+inline RingBuffer& thread_buffer() {
+  thread_local auto const local = ThreadBuffer{};
+  return *local.buffer;
+}
+
+/**
+ * @brief      Current steady_clock time in nanoseconds
+ */
+inline int64_t now_ns() noexcept {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+/**
+ * @brief      A pipeline stage with a name to use in the trace instead of its
+ * type name.  Useful for function pointers which all share a type name.
+ *
+ * @tparam     F     The function type
+ */
+template <typename F>
+struct Named {
+  char const* name;
+  F f;
+
+  template <typename... Args>
+  constexpr auto operator()(Args&&... args) const
+      -> decltype(f(std::forward<Args>(args)...)) {
+    return f(std::forward<Args>(args)...);
+  }
+};
+
+template <typename F>
+constexpr bool is_named_v = false;
+template <typename F>
+constexpr bool is_named_v<Named<F>> = true;
+
+/**
+ * @brief      Give a pipeline stage a name for tracing.  When tracing is
+ * disabled this returns f unchanged.
+ *
+ * @param[in]  name  The name, must be a string literal or otherwise outlive
+ * the trace
+ * @param[in]  f     The function
+ *
+ * @tparam     F     The function type
+ */
+template <typename F>
+constexpr auto named([[maybe_unused]] char const* name, F f) {
+#ifdef FP_ENABLE_TRACING
+  return Named<F>{name, f};
+#else
+  return f;
+#endif
+}
+
+/**
+ * @brief      Invoke a pipeline stage and record its entry and exit times and
+ * whether it returned a value into the ring buffer of the calling thread.
+ *
+ * @param[in]  f     The stage
+ * @param[in]  args  The arguments
+ *
+ * @tparam     F     The stage type
+ * @tparam     Args  The argument types
+ *
+ * @return     The return value of f
+ */
+template <typename F, typename... Args>
+auto invoke(F& f, Args&&... args) {
+  auto const begin = now_ns();
+  auto ret = f(std::forward<Args>(args)...);
+  auto const end = now_ns();
+  if constexpr (is_named_v<std::remove_cv_t<F>>) {
+    thread_buffer().push(
+        Record{f.name, false, static_cast<bool>(ret), begin, end});
+  } else {
+    thread_buffer().push(
+        Record{typeid(F).name(), true, static_cast<bool>(ret), begin, end});
+  }
+  return ret;
+}
+
+/**
+ * @brief      Snapshot of the records of all threads
+ *
+ * @return     Pairs of thread id and the records of that thread
+ */
+inline std::vector<std::pair<int, std::vector<Record>>> records() {
+  auto all = std::vector<std::pair<int, std::vector<Record>>>{};
+  for (auto const& buffer : Registry::instance().buffers()) {
+    all.emplace_back(buffer->tid, buffer->snapshot());
+  }
+  return all;
+}
+
+/**
+ * @brief      Drop all the records recorded so far
+ */
+inline void clear() {
+  for (auto const& buffer : Registry::instance().buffers()) {
+    buffer->clear();
+  }
+}
+
+/**
+ * @brief      Name of the stage of a record, demangled if it is a type name
+ */
+inline std::string name(Record const& record) {
+  if (!record.mangled) return record.name;
+  int status = 0;
+  auto const demangled = std::unique_ptr<char, decltype(&std::free)>{
+      abi::__cxa_demangle(record.name, nullptr, nullptr, &status), &std::free};
+  return status == 0 ? std::string{demangled.get()} : std::string{record.name};
+}
+
+/**
+ * @brief      Format the records of all threads as Chrome trace event JSON.
+ * This can be loaded in chrome://tracing or https://ui.perfetto.dev
+ *
+ * @return     The JSON string
+ */
+inline std::string chrome_trace_json() {
+  auto const escape = [](std::string_view in) {
+    auto out = std::string{};
+    out.reserve(in.size());
+    for (auto const c : in) {
+      if (c == '"' || c == '\\') out.push_back('\\');
+      out.push_back(c);
+    }
+    return out;
+  };
+
+  auto out = fmt::memory_buffer{};
+  fmt::format_to(std::back_inserter(out), "{{\"traceEvents\":[");
+  auto first = true;
+  for (auto const& [tid, thread_records] : records()) {
+    for (auto const& record : thread_records) {
+      fmt::format_to(std::back_inserter(out),
+                     "{}{{\"name\":\"{}\",\"cat\":\"fp\",\"ph\":\"X\","
+                     "\"ts\":{:.3f},\"dur\":{:.3f},\"pid\":0,\"tid\":{},"
+                     "\"args\":{{\"ok\":{}}}}}",
+                     first ? "" : ",", escape(name(record)),
+                     static_cast<double>(record.begin_ns) / 1e3,
+                     static_cast<double>(record.end_ns - record.begin_ns) / 1e3,
+                     tid, record.ok);
+      first = false;
+    }
+  }
+  fmt::format_to(std::back_inserter(out), "]}}");
+  return fmt::to_string(out);
+}
+
+/**
+ * @brief      Write the records of all threads as Chrome trace event JSON
+ *
+ * @param[in]  path  The file to write
+ *
+ * @return     Unavailable error if the file could not be written
+ */
+inline Result<void> write_chrome_trace(std::string const& path) {
+  return detail::write_file(path, chrome_trace_json(), "trace");
+}
+
+}  // namespace fp::trace
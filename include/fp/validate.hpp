@@ -31,10 +31,11 @@
 #include <fmt/format.h>
 #include <fmt/ranges.h>
 
+#include <algorithm>
 #include <cmath>
 #include <limits>
 #include <optional>
-#include <range/v3/all.hpp>
+#include <type_traits>
 
 #include "fp/result.hpp"
 
@@ -62,14 +63,39 @@ struct validate_range {
     }
 
     if (step) {
-      double const step_value = static_cast<double>(step.value());
-      double const ratio = static_cast<double>(value - from) / step_value;
-      double const distance = fabs(ratio - round(ratio));
+      if constexpr (std::is_integral_v<T> && !std::is_same_v<T, bool>) {
+        // Exact modulo in the unsigned type, value >= from so the difference
+        // cannot overflow and there is no loss of precision above 2^53
+        using U = std::make_unsigned_t<T>;
+        U const offset = static_cast<U>(value) - static_cast<U>(from);
+        U const step_value = step.value() < 0
+                                 ? U{0} - static_cast<U>(step.value())
+                                 : static_cast<U>(step.value());
+        if (step_value == 0) return value;
 
-      if (distance > step_threshold) {
-        return tl::make_unexpected(OutOfRange(
-            fmt::format("{}: {} is {} away from the nearest valid step", name,
-                        value, distance)));
+        U const remainder = offset % step_value;
+        if (remainder != 0) {
+          // 8 and 16 bit U are promoted to int by the subtraction
+          double const distance =
+              static_cast<double>(std::min<U>(
+                  remainder, static_cast<U>(step_value - remainder))) /
+              static_cast<double>(step_value);
+          return tl::make_unexpected(OutOfRange(
+              fmt::format("{}: {} is {} away from the nearest valid step", name,
+                          value, distance)));
+        }
+      } else {
+        // Unlike round, nearbyint can be inlined (roundsd with SSE4.1) so
+        // bulk validation vectorizes, ties give the same distance either way
+        double const step_value = static_cast<double>(step.value());
+        double const ratio = static_cast<double>(value - from) / step_value;
+        double const distance = std::abs(ratio - std::nearbyint(ratio));
+
+        if (distance > step_threshold) {
+          return tl::make_unexpected(OutOfRange(
+              fmt::format("{}: {} is {} away from the nearest valid step", name,
+                          value, distance)));
+        }
       }
     }
 
@@ -94,8 +120,8 @@ struct validate_range {
 template <typename Rng, typename T>
 constexpr Result<T> validate_in(Rng const& valid_values, T const& value,
                                 std::string const& name) {
-  if (ranges::contains(valid_values, value)) {
-    return value;
+  for (auto const& valid_value : valid_values) {
+    if (valid_value == value) return value;
   }
   return tl::make_unexpected(
       OutOfRange(fmt::format("{} is not in {}", value, valid_values)));
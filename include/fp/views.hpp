@@ -0,0 +1,228 @@
+// Copyright (c) 2022, Tyler Weaver
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <iterator>
+#include <range/v3/range/traits.hpp>
+#include <range/v3/view/all.hpp>
+#include <range/v3/view/cache1.hpp>
+#include <range/v3/view/filter.hpp>
+#include <range/v3/view/transform.hpp>
+#include <type_traits>
+#include <utility>
+
+#include "fp/result.hpp"
+
+namespace fp {
+namespace detail {
+
+/**
+ * @brief      True if dereferencing the iterators of Rng produces a temporary
+ */
+template <typename Rng>
+constexpr bool has_prvalue_reference_v =
+    !std::is_reference_v<ranges::range_reference_t<Rng>>;
+
+/**
+ * @brief      View of rng where each element is produced only once
+ *
+ * Filtering dereferences each element twice, which would call an upstream
+ * transform twice. Ranges of temporaries are cached so the work is done once
+ * and the cached element can be moved from.
+ */
+template <typename Rng>
+auto cache_prvalues(Rng&& rng) {
+  if constexpr (has_prvalue_reference_v<Rng>) {
+    return std::forward<Rng>(rng) | ranges::views::cache1;
+  } else {
+    return ranges::views::all(std::forward<Rng>(rng));
+  }
+}
+
+struct HasValue {
+  template <typename R>
+  constexpr bool operator()(R const& result) const {
+    return result.has_value();
+  }
+};
+
+struct HasError {
+  template <typename R>
+  constexpr bool operator()(R const& result) const {
+    return !result.has_value();
+  }
+};
+
+/// Forwards the value, a reference into the source for lvalue elements
+struct ForwardValue {
+  template <typename R>
+  constexpr decltype(auto) operator()(R&& result) const {
+    return *std::forward<R>(result);
+  }
+};
+
+/// Moves the value out of an element owned by the view
+struct MoveValue {
+  template <typename R>
+  constexpr auto operator()(R&& result) const {
+    return std::move(*result);
+  }
+};
+
+struct ForwardError {
+  template <typename R>
+  constexpr decltype(auto) operator()(R&& result) const {
+    return std::forward<R>(result).error();
+  }
+};
+
+struct MoveError {
+  template <typename R>
+  constexpr auto operator()(R&& result) const {
+    return std::move(result.error());
+  }
+};
+
+template <typename F>
+struct AndThen {
+  F f;
+
+  template <typename R>
+  constexpr auto operator()(R&& result) const {
+    return std::forward<R>(result).and_then(f);
+  }
+};
+
+template <typename F>
+struct Map {
+  F f;
+
+  template <typename R>
+  constexpr auto operator()(R&& result) const {
+    return std::forward<R>(result).map(f);
+  }
+};
+
+template <typename Predicate, typename Forward, typename Move>
+struct Select {
+  template <typename Rng>
+  friend auto operator|(Rng&& rng, Select) {
+    using Project = std::conditional_t<has_prvalue_reference_v<Rng>, Move,
+                                       Forward>;
+    return cache_prvalues(std::forward<Rng>(rng)) |
+           ranges::views::filter(Predicate{}) |
+           ranges::views::transform(Project{});
+  }
+};
+
+}  // namespace detail
+
+namespace views {
+
+/**
+ * @brief      Range adaptor calling and_then with f on each Result<T>
+ *
+ * @param[in]  f     Function from T to Result<U>
+ *
+ * @return     Range adaptor producing Result<U>
+ */
+template <typename F>
+auto and_then(F f) {
+  return ranges::views::transform(detail::AndThen<F>{std::move(f)});
+}
+
+/**
+ * @brief      Range adaptor calling map with f on each Result<T>
+ *
+ * @param[in]  f     Function from T to U
+ *
+ * @return     Range adaptor producing Result<U>
+ */
+template <typename F>
+auto map(F f) {
+  return ranges::views::transform(detail::Map<F>{std::move(f)});
+}
+
+/**
+ * @brief      Range adaptor producing the values of the successful results
+ *
+ * Values of a container are referenced, values of temporaries (for example
+ * from an upstream transform) are moved out.
+ */
+inline constexpr auto values =
+    detail::Select<detail::HasValue, detail::ForwardValue, detail::MoveValue>{};
+
+/**
+ * @brief      Range adaptor producing the errors of the failed results
+ */
+inline constexpr auto errors =
+    detail::Select<detail::HasError, detail::ForwardError, detail::MoveError>{};
+
+}  // namespace views
+
+/**
+ * @brief      Split a range of Result<T> into values and errors in one pass
+ *
+ * Each element is visited once. Elements that are temporaries or rvalue
+ * references are moved from, use ranges::views::move to move out of a
+ * container.
+ *
+ * @param[in]  rng           The range of Result<T>
+ * @param[in]  values_first  Output iterator for the values
+ * @param[in]  errors_first  Output iterator for the errors
+ *
+ * @return     Pair of the output iterators one past the last written
+ */
+template <typename Rng, typename ValueOut, typename ErrorOut>
+std::pair<ValueOut, ErrorOut> partition_results(Rng&& rng,
+                                                ValueOut values_first,
+                                                ErrorOut errors_first) {
+  constexpr bool move_elements =
+      !std::is_lvalue_reference_v<ranges::range_reference_t<Rng>>;
+  for (auto&& result : rng) {
+    if (result.has_value()) {
+      if constexpr (move_elements) {
+        *values_first = std::move(*result);
+      } else {
+        *values_first = *result;
+      }
+      ++values_first;
+    } else {
+      if constexpr (move_elements) {
+        *errors_first = std::move(result.error());
+      } else {
+        *errors_first = result.error();
+      }
+      ++errors_first;
+    }
+  }
+  return {values_first, errors_first};
+}
+
+}  // namespace fp
@@ -0,0 +1,70 @@
+// Copyright (c) 2022, Tyler Weaver
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#pragma once
+
+#include <fmt/format.h>
+
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "fp/result.hpp"
+
+namespace fp::detail {
+
+/**
+ * @brief      Replace the contents of a file
+ *
+ * @param[in]  path      The file to write
+ * @param[in]  contents  The contents
+ * @param[in]  what      What the contents are, for the error message
+ *
+ * @return     Unavailable error if the file could not be opened, DataLoss if
+ * it could not be written
+ */
+inline Result<void> write_file(std::string const& path,
+                               std::string_view contents,
+                               std::string_view what) {
+  auto const file = std::unique_ptr<std::FILE, decltype(&std::fclose)>{
+      std::fopen(path.c_str(), "w"), &std::fclose};
+  if (!file) {
+    return tl::make_unexpected(
+        Unavailable(fmt::format("could not open {} for writing", path)));
+  }
+  if (std::fwrite(contents.data(), 1, contents.size(), file.get()) !=
+      contents.size()) {
+    return tl::make_unexpected(
+        DataLoss(fmt::format("could not write the {} to {}", what, path)));
+  }
+  return {};
+}
+
+}  // namespace fp::detail
@@ -0,0 +1,152 @@
+// Copyright 2022 PickNik Inc
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the PickNik Inc nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "fp/all.hpp"
+#include "gtest/gtest.h"
+
+namespace {
+/// Stage that blocks until it is released
+struct Gate {
+  std::shared_ptr<std::promise<void>> open =
+      std::make_shared<std::promise<void>>();
+  std::shared_future<void> opened = open->get_future().share();
+  std::shared_ptr<std::atomic<int>> entered =
+      std::make_shared<std::atomic<int>>(0);
+
+  fp::Result<int> operator()(int x) const {
+    entered->fetch_add(1);
+    opened.wait();
+    return x;
+  }
+
+  void wait_entered(int count) const {
+    while (entered->load() < count) std::this_thread::yield();
+  }
+};
+}  // namespace
+
+TEST(BulkheadTests, PassesThrough) {
+  // GIVEN a stage behind a bulkhead
+  const auto twice = [](int x) { return fp::make_result(x * 2); };
+  const auto limited = fp::bulkhead(twice, 2);
+
+  // WHEN we call it in a pipeline
+  const auto result = fp::make_result(3) | limited;
+
+  // THEN we expect the value and no calls left in flight
+  EXPECT_EQ(result, fp::make_result(6));
+  EXPECT_EQ(limited.stats().in_flight, 0U);
+}
+
+TEST(BulkheadTests, ZeroConcurrencyIsInvalid) {
+  // GIVEN a limit of 0 calls at once
+  // WHEN we make a bulkhead with it
+  // THEN we expect invalid_argument
+  const auto twice = [](int x) { return fp::make_result(x * 2); };
+  EXPECT_THROW((void)fp::bulkhead(twice, 0), std::invalid_argument);
+  EXPECT_THROW((void)fp::bulkhead(twice, 0, 10), std::invalid_argument);
+}
+
+TEST(BulkheadTests, FailFast) {
+  // GIVEN a bulkhead of one slot and no wait list with a call in flight
+  const auto gate = Gate{};
+  const auto limited = fp::bulkhead(gate, 1);
+  auto first = std::async(std::launch::async, [&] { return limited(1); });
+  gate.wait_entered(1);
+
+  // WHEN we call it again
+  const auto second = limited(2);
+
+  // THEN we expect the call rejected
+  EXPECT_EQ(second.error().code, fp::ErrorCode::RESOURCE_EXHAUSTED);
+  EXPECT_EQ(limited.stats().in_flight, 1U);
+  EXPECT_EQ(limited.stats().rejected, 1U);
+  gate.open->set_value();
+  EXPECT_EQ(first.get(), fp::make_result(1));
+}
+
+TEST(BulkheadTests, Queue) {
+  // GIVEN a bulkhead of one slot and a wait list of one with a call in flight
+  const auto gate = Gate{};
+  const auto limited = fp::bulkhead(gate, 1, 1);
+  auto first = std::async(std::launch::async, [&] { return limited(1); });
+  gate.wait_entered(1);
+
+  // WHEN a second call waits and a third arrives
+  auto second = std::async(std::launch::async, [&] { return limited(2); });
+  while (limited.stats().waiting < 1) std::this_thread::yield();
+  const auto third = limited(3);
+
+  // THEN we expect the third rejected and the second to run after the first
+  EXPECT_EQ(third.error().code, fp::ErrorCode::RESOURCE_EXHAUSTED);
+  gate.open->set_value();
+  EXPECT_EQ(first.get(), fp::make_result(1));
+  EXPECT_EQ(second.get(), fp::make_result(2));
+  EXPECT_EQ(limited.stats().in_flight, 0U);
+}
+
+TEST(BulkheadTests, LimitsConcurrency) {
+  // GIVEN a stage that tracks how many calls run at once
+  auto running = std::atomic<int>{0};
+  auto max_running = std::atomic<int>{0};
+  const auto stage = [&](int x) -> fp::Result<int> {
+    const auto now = running.fetch_add(1) + 1;
+    auto seen = max_running.load();
+    while (now > seen && !max_running.compare_exchange_weak(seen, now)) {
+    }
+    std::this_thread::sleep_for(std::chrono::microseconds{100});
+    running.fetch_sub(1);
+    return x;
+  };
+  const auto limited = fp::bulkhead(stage, 2, 16);
+
+  // WHEN we call it from many threads
+  auto threads = std::vector<std::thread>{};
+  for (int t = 0; t < 8; ++t) {
+    threads.emplace_back([&limited] {
+      for (int i = 0; i < 20; ++i) EXPECT_TRUE(limited(i));
+    });
+  }
+  for (auto& thread : threads) thread.join();
+
+  // THEN we expect no more than two calls at once
+  EXPECT_LE(max_running.load(), 2);
+  EXPECT_EQ(limited.stats().rejected, 0U);
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,260 @@
+// Copyright 2022 PickNik Inc
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the PickNik Inc nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "fp/all.hpp"
+#include "gtest/gtest.h"
+
+namespace {
+/// Clock advanced by hand
+struct FakeClock {
+  using duration = std::chrono::nanoseconds;
+  using time_point = std::chrono::time_point<FakeClock>;
+
+  std::shared_ptr<duration> current = std::make_shared<duration>(0);
+
+  time_point now() const { return time_point{*current}; }
+  void advance(duration d) const { *current += d; }
+};
+
+/// Dependency that fails with a given error until it is healthy
+struct FakeDependency {
+  std::shared_ptr<int> calls = std::make_shared<int>(0);
+  std::shared_ptr<std::optional<fp::Error>> failure =
+      std::make_shared<std::optional<fp::Error>>();
+
+  fp::Result<int> operator()(int x) const {
+    ++*calls;
+    if (*failure) return tl::make_unexpected(failure->value());
+    return x * 2;
+  }
+};
+
+fp::CircuitBreakerPolicy test_policy() {
+  auto policy = fp::CircuitBreakerPolicy{};
+  policy.minimum_calls = 4;
+  policy.failure_ratio = 0.5;
+  policy.window = std::chrono::seconds{10};
+  policy.cooldown = std::chrono::seconds{1};
+  return policy;
+}
+}  // namespace
+
+TEST(CircuitBreakerTests, ClosedPassesThrough) {
+  // GIVEN a healthy dependency behind a breaker
+  const auto dependency = FakeDependency{};
+  const auto breaker =
+      fp::circuit_breaker(dependency, test_policy(), FakeClock{});
+
+  // WHEN we call it in a pipeline
+  const auto result = fp::make_result(2) | breaker;
+
+  // THEN we expect the value of the dependency
+  EXPECT_EQ(result, fp::make_result(4));
+  EXPECT_EQ(breaker.state(), fp::CircuitState::CLOSED);
+}
+
+TEST(CircuitBreakerTests, OpensAfterFailures) {
+  // GIVEN an unavailable dependency behind a breaker
+  const auto dependency = FakeDependency{};
+  *dependency.failure = fp::Timeout("slow");
+  const auto breaker =
+      fp::circuit_breaker(dependency, test_policy(), FakeClock{});
+
+  // WHEN we call it until the minimum number of calls
+  for (int i = 0; i < 4; ++i) {
+    EXPECT_EQ(breaker(i).error().code, fp::ErrorCode::TIMEOUT);
+  }
+
+  // THEN we expect it to open and fail without calling the dependency
+  EXPECT_EQ(breaker.state(), fp::CircuitState::OPEN);
+  const auto result = breaker(5);
+  EXPECT_EQ(result.error().code, fp::ErrorCode::UNAVAILABLE);
+  EXPECT_EQ(*dependency.calls, 4);
+  EXPECT_EQ(breaker.stats().rejected, 1U);
+}
+
+TEST(CircuitBreakerTests, ProbeCloses) {
+  // GIVEN an open breaker whose dependency recovered
+  const auto clock = FakeClock{};
+  const auto dependency = FakeDependency{};
+  *dependency.failure = fp::Unavailable();
+  const auto breaker = fp::circuit_breaker(dependency, test_policy(), clock);
+  for (int i = 0; i < 4; ++i) (void)breaker(i);
+  ASSERT_EQ(breaker.state(), fp::CircuitState::OPEN);
+  dependency.failure->reset();
+
+  // WHEN the cooldown passes and we call it
+  clock.advance(std::chrono::seconds{2});
+  const auto result = breaker(3);
+
+  // THEN we expect the probe to succeed and the breaker to close
+  EXPECT_EQ(result, fp::make_result(6));
+  EXPECT_EQ(breaker.state(), fp::CircuitState::CLOSED);
+  EXPECT_EQ(breaker.stats().window_calls, 0U);
+}
+
+TEST(CircuitBreakerTests, ProbeReopens) {
+  // GIVEN an open breaker whose dependency is still unavailable
+  const auto clock = FakeClock{};
+  const auto dependency = FakeDependency{};
+  *dependency.failure = fp::Unavailable();
+  const auto breaker = fp::circuit_breaker(dependency, test_policy(), clock);
+  for (int i = 0; i < 4; ++i) (void)breaker(i);
+
+  // WHEN the cooldown passes and the probe fails
+  clock.advance(std::chrono::seconds{2});
+  (void)breaker(1);
+
+  // THEN we expect the breaker to open for another cooldown
+  EXPECT_EQ(breaker.state(), fp::CircuitState::OPEN);
+  EXPECT_EQ(*dependency.calls, 5);
+  (void)breaker(1);
+  EXPECT_EQ(*dependency.calls, 5);
+}
+
+TEST(CircuitBreakerTests, ThrowingProbeReleasesSlot) {
+  // GIVEN an open breaker whose dependency throws on the probe
+  const auto clock = FakeClock{};
+  const auto dependency = FakeDependency{};
+  *dependency.failure = fp::Unavailable();
+  const auto breaker = fp::circuit_breaker(dependency, test_policy(), clock);
+  for (int i = 0; i < 4; ++i) (void)breaker(i);
+  auto throwing = true;
+  const auto flaky = fp::CircuitBreaker<std::function<fp::Result<int>(int)>,
+                                        FakeClock>{
+      breaker.breaker, [&](int x) -> fp::Result<int> {
+        if (throwing) throw std::runtime_error("connection reset");
+        return x;
+      }};
+
+  // WHEN the cooldown passes and the probe throws
+  clock.advance(std::chrono::seconds{2});
+  EXPECT_THROW((void)flaky(1), std::runtime_error);
+
+  // THEN the probe counts as failed, and after another cooldown a probe runs
+  EXPECT_EQ(breaker.state(), fp::CircuitState::OPEN);
+  throwing = false;
+  clock.advance(std::chrono::seconds{100});
+  EXPECT_EQ(flaky(7), fp::make_result(7));
+  EXPECT_EQ(breaker.state(), fp::CircuitState::CLOSED);
+}
+
+TEST(CircuitBreakerTests, LateFailureKeepsOpenTime) {
+  // GIVEN a call that fails after other calls opened the breaker
+  const auto clock = FakeClock{};
+  const auto dependency = FakeDependency{};
+  *dependency.failure = fp::Unavailable();
+  const auto breaker = fp::circuit_breaker(dependency, test_policy(), clock);
+  const auto slow = fp::CircuitBreaker<std::function<fp::Result<int>(int)>,
+                                       FakeClock>{
+      breaker.breaker, [&](int) -> fp::Result<int> {
+        for (int i = 0; i < 4; ++i) (void)breaker(i);
+        clock.advance(std::chrono::milliseconds{900});
+        return tl::make_unexpected(fp::Timeout("slow"));
+      }};
+
+  // WHEN its failure is recorded while the breaker is open
+  (void)slow(1);
+  ASSERT_EQ(breaker.state(), fp::CircuitState::OPEN);
+
+  // THEN we expect the probe one cooldown after the breaker opened
+  dependency.failure->reset();
+  clock.advance(std::chrono::milliseconds{200});
+  EXPECT_EQ(breaker(3), fp::make_result(6));
+  EXPECT_EQ(breaker.state(), fp::CircuitState::CLOSED);
+}
+
+TEST(CircuitBreakerTests, OtherErrorsDoNotOpen) {
+  // GIVEN a dependency that fails with NotFound
+  const auto dependency = FakeDependency{};
+  *dependency.failure = fp::NotFound();
+  const auto breaker =
+      fp::circuit_breaker(dependency, test_policy(), FakeClock{});
+
+  // WHEN we call it many times
+  for (int i = 0; i < 10; ++i) (void)breaker(i);
+
+  // THEN we expect it to stay closed
+  EXPECT_EQ(breaker.state(), fp::CircuitState::CLOSED);
+  EXPECT_EQ(*dependency.calls, 10);
+}
+
+TEST(CircuitBreakerTests, WindowResets) {
+  // GIVEN a dependency that fails now and then
+  const auto clock = FakeClock{};
+  const auto dependency = FakeDependency{};
+  *dependency.failure = fp::Unavailable();
+  const auto breaker = fp::circuit_breaker(dependency, test_policy(), clock);
+
+  // WHEN fewer than the minimum calls fail in each window
+  for (int i = 0; i < 9; ++i) {
+    (void)breaker(i);
+    if (i % 3 == 2) clock.advance(std::chrono::seconds{11});
+  }
+
+  // THEN we expect it to stay closed
+  EXPECT_EQ(breaker.state(), fp::CircuitState::CLOSED);
+}
+
+TEST(CircuitBreakerTests, Concurrent) {
+  // GIVEN a breaker in front of an unavailable dependency
+  auto calls = std::make_shared<std::atomic<int>>(0);
+  const auto dependency = [calls](int) -> fp::Result<int> {
+    calls->fetch_add(1);
+    return tl::make_unexpected(fp::Unavailable());
+  };
+  const auto breaker = fp::circuit_breaker(dependency, test_policy());
+
+  // WHEN we call it from several threads
+  auto threads = std::vector<std::thread>{};
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([&breaker] {
+      for (int i = 0; i < 1000; ++i) (void)breaker(i);
+    });
+  }
+  for (auto& thread : threads) thread.join();
+
+  // THEN we expect most calls rejected once it opened
+  EXPECT_EQ(breaker.state(), fp::CircuitState::OPEN);
+  EXPECT_LT(calls->load(), 100);
+  EXPECT_EQ(breaker.stats().rejected + calls->load(), 4000U);
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,106 @@
+// Copyright 2022 PickNik Inc
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the PickNik Inc nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <vector>
+
+#include "fp/all.hpp"
+#include "gtest/gtest.h"
+
+using Real = fp::compact_optional<double, fp::nan_sentinel<double>>;
+using Index = fp::compact_optional<int32_t, fp::value_sentinel<int32_t, -1>>;
+
+static_assert(sizeof(Real) == sizeof(double));
+static_assert(sizeof(Index) == sizeof(int32_t));
+static_assert(std::is_trivially_copyable_v<Real>);
+
+TEST(CompactOptionalTests, DefaultIsEmpty) {
+  // GIVEN default constructed compact optionals
+  const auto real = Real{};
+  const auto index = Index{std::nullopt};
+
+  // THEN we expect them to be empty
+  EXPECT_FALSE(real.has_value());
+  EXPECT_FALSE(index);
+  EXPECT_THROW((void)real.value(), std::bad_optional_access);
+  EXPECT_EQ(index.value_or(7), 7);
+}
+
+TEST(CompactOptionalTests, Value) {
+  // GIVEN compact optionals with values
+  const auto real = Real{0.5};
+  const auto index = Index{3};
+
+  // THEN we expect the values
+  EXPECT_TRUE(real);
+  EXPECT_EQ(real.value(), 0.5);
+  EXPECT_EQ(*index, 3);
+  EXPECT_EQ(index.to_optional(), std::optional<int32_t>{3});
+}
+
+TEST(CompactOptionalTests, SentinelIsEmpty) {
+  // GIVEN compact optionals made from their sentinel values
+  const auto real = Real{std::numeric_limits<double>::quiet_NaN()};
+  const auto index = Index{-1};
+
+  // THEN we expect them to be empty
+  EXPECT_FALSE(real);
+  EXPECT_FALSE(index);
+  EXPECT_EQ(real, Real{});
+}
+
+TEST(CompactOptionalTests, FromOptionalAndReset) {
+  // GIVEN a compact optional made from a std::optional
+  auto index = Index{std::optional<int32_t>{4}};
+  ASSERT_TRUE(index);
+
+  // WHEN we reset it
+  index.reset();
+
+  // THEN we expect it to be empty
+  EXPECT_FALSE(index);
+  EXPECT_EQ(index.to_optional(), std::nullopt);
+}
+
+TEST(CompactOptionalTests, DenseVector) {
+  // GIVEN a vector of compact optionals
+  const auto values = std::vector<Real>{Real{1.0}, Real{}, Real{3.0}};
+
+  // THEN we expect the elements to be stored like doubles
+  EXPECT_EQ(reinterpret_cast<char const*>(&values[1]) -
+                reinterpret_cast<char const*>(&values[0]),
+            static_cast<std::ptrdiff_t>(sizeof(double)));
+  EXPECT_FALSE(values[1]);
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
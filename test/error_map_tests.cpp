@@ -0,0 +1,169 @@
+// Copyright 2022 PickNik Inc
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the PickNik Inc nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <utility>
+
+#include "fp/all.hpp"
+#include "gtest/gtest.h"
+
+namespace {
+enum class ConveyorError { BELT_STALLED, SENSOR_BLOCKED };
+}  // namespace
+
+template <>
+struct fp::ErrorDomain<ConveyorError> {
+  static constexpr std::string_view name = "conveyor";
+  static constexpr fp::ErrorCode canonical(ConveyorError) {
+    return fp::ErrorCode::UNAVAILABLE;
+  }
+  static constexpr std::string_view to_string(ConveyorError code) {
+    return code == ConveyorError::BELT_STALLED ? "BeltStalled"
+                                               : "SensorBlocked";
+  }
+};
+
+TEST(ErrorMapTests, CountsEqualErrors) {
+  // GIVEN a map of counts
+  auto counts = fp::ErrorMap<int>{};
+
+  // WHEN equal errors from different places are counted
+  for (int i = 0; i < 3; ++i) ++counts[fp::NotFound("missing")];
+  ++counts[fp::Timeout("missing")];
+  ++counts[fp::NotFound("gone")];
+
+  // THEN errors are grouped by code and message
+  ASSERT_EQ(counts.size(), 3U);
+  EXPECT_EQ(counts[fp::NotFound("missing")], 3);
+  EXPECT_EQ(counts[fp::Timeout("missing")], 1);
+  EXPECT_EQ(counts[fp::NotFound("gone")], 1);
+}
+
+TEST(ErrorMapTests, FindAggregateInitialized) {
+  // GIVEN a map with an error made by a factory
+  auto map = fp::ErrorMap<std::string>{};
+  map.try_emplace(fp::InvalidArgument("bad value"), "first");
+
+  // WHEN we find an equal error that was aggregate initialized
+  auto const it = map.find(
+      fp::Error{fp::ErrorCode::INVALID_ARGUMENT, std::string{"bad value"}});
+
+  // THEN it is found
+  ASSERT_NE(it, map.end());
+  EXPECT_EQ(it->second, "first");
+  EXPECT_EQ(map.count(fp::InvalidArgument("other")), 0U);
+}
+
+TEST(ErrorMapTests, GrowsKeepingEntries) {
+  // GIVEN many distinct errors
+  auto map = fp::ErrorMap<size_t>{};
+
+  // WHEN they are inserted, growing the map several times
+  for (size_t i = 0; i < 1000; ++i) {
+    auto const [it, inserted] =
+        map.try_emplace(fp::Internal(std::to_string(i)), i);
+    ASSERT_TRUE(inserted);
+  }
+
+  // THEN every error is found with its value, in insertion order
+  ASSERT_EQ(map.size(), 1000U);
+  for (size_t i = 0; i < 1000; ++i) {
+    EXPECT_EQ(map[fp::Internal(std::to_string(i))], i);
+  }
+  size_t expected = 0;
+  for (auto const& [error, value] : map) EXPECT_EQ(value, expected++);
+}
+
+TEST(ErrorMapTests, HashMatchesEquality) {
+  // GIVEN an error whose message is changed after it was made
+  auto changed = fp::DataLoss("truncated");
+  changed.what = "corrupt";
+
+  // WHEN we compare and hash it with an error made with that message
+  const auto made = fp::DataLoss("corrupt");
+
+  // THEN they are equal and have the same hash, and work in std containers
+  EXPECT_EQ(changed, made);
+  EXPECT_NE(changed, fp::DataLoss("truncated"));
+  EXPECT_EQ(std::hash<fp::Error>{}(changed), std::hash<fp::Error>{}(made));
+  auto const set = std::unordered_set<fp::Error>{changed, made};
+  EXPECT_EQ(set.size(), 1U);
+  auto counts = fp::ErrorMap<int>{};
+  ++counts[changed];
+  ++counts[made];
+  EXPECT_EQ(counts.size(), 1U);
+}
+
+TEST(ErrorMapTests, DomainCodesAreDistinct) {
+  // GIVEN errors of two domain codes with the same canonical code and message
+  const auto stalled = fp::make_error(ConveyorError::BELT_STALLED);
+  const auto blocked = fp::make_error(ConveyorError::SENSOR_BLOCKED);
+  ASSERT_EQ(stalled.code, blocked.code);
+
+  // WHEN we compare, hash and count them
+  auto counts = fp::ErrorMap<int>{};
+  ++counts[stalled];
+  ++counts[blocked];
+  ++counts[fp::make_error(ConveyorError::BELT_STALLED)];
+
+  // THEN we expect them to be different errors
+  EXPECT_NE(stalled, blocked);
+  EXPECT_NE(stalled, fp::Unavailable(""));
+  EXPECT_NE(std::hash<fp::Error>{}(stalled), std::hash<fp::Error>{}(blocked));
+  ASSERT_EQ(counts.size(), 2U);
+  EXPECT_EQ(counts[stalled], 2);
+  EXPECT_EQ(counts[blocked], 1);
+}
+
+TEST(ErrorMapTests, HashedErrorKeys) {
+  // GIVEN a map keyed by errors that carry their hash
+  auto counts = fp::ErrorMap<int, fp::HashedError>{};
+  const auto missing = fp::HashedError{fp::NotFound("missing")};
+
+  // WHEN errors are counted and looked up
+  for (int i = 0; i < 3; ++i) ++counts[missing];
+  ++counts[fp::NotFound("gone")];
+
+  // THEN we expect them grouped like errors, using the stored hash
+  EXPECT_EQ(missing.hash(), std::hash<fp::Error>{}(missing.error()));
+  EXPECT_EQ(missing, fp::HashedError{fp::NotFound("missing")});
+  EXPECT_NE(missing, fp::HashedError{fp::Timeout("missing")});
+  ASSERT_EQ(counts.size(), 2U);
+  EXPECT_EQ(counts.find(missing)->second, 3);
+  EXPECT_EQ(std::as_const(counts).find(fp::NotFound("gone"))->second, 1);
+  EXPECT_EQ(counts.count(fp::NotFound("other")), 0U);
+  EXPECT_EQ(std::unordered_set<fp::HashedError>({missing, missing}).size(),
+            1U);
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
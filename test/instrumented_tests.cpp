@@ -0,0 +1,187 @@
+// Copyright 2022 PickNik Inc
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the PickNik Inc nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "fp/all.hpp"
+#include "gtest/gtest.h"
+
+fp::Result<double> divide_4_by(double val) {
+  if (val == 0) {
+    return tl::make_unexpected(fp::InvalidArgument());
+  }
+  return 4.0 / val;
+}
+
+fp::PipelineStats stats_for(std::string const& name) {
+  for (auto const& stats : fp::pipeline_stats()) {
+    if (stats.name == name) return stats;
+  }
+  return {};
+}
+
+TEST(InstrumentedTests, BucketsRoundTrip) {
+  // GIVEN values across the range of the histogram
+  for (uint64_t value : {0ul, 1ul, 15ul, 16ul, 17ul, 1000ul, 123456789ul}) {
+    // WHEN we find the bucket of the value
+    const auto index = fp::LatencyBuckets::index(value);
+
+    // THEN we expect the value to be within the bounds of the bucket
+    EXPECT_LE(fp::LatencyBuckets::lower_bound(index), value);
+    EXPECT_GE(fp::LatencyBuckets::upper_bound(index), value);
+  }
+}
+
+TEST(InstrumentedTests, BucketsRelativeError) {
+  // GIVEN a large value
+  const uint64_t value = 987654321;
+
+  // WHEN we find the width of its bucket
+  const auto index = fp::LatencyBuckets::index(value);
+  const auto width = fp::LatencyBuckets::upper_bound(index) -
+                     fp::LatencyBuckets::lower_bound(index);
+
+  // THEN we expect it to be within 6.25% of the value
+  EXPECT_LE(static_cast<double>(width), 0.0625 * value);
+}
+
+TEST(InstrumentedTests, Quantile) {
+  // GIVEN a histogram with 99 values of 10 and one of 1000
+  auto histogram = fp::LatencyHistogram{};
+  for (int i = 0; i < 99; ++i) histogram.record(10);
+  histogram.record(1000);
+
+  // WHEN we get the quantiles
+  auto snapshot = fp::HistogramSnapshot{};
+  histogram.merge_into(snapshot);
+
+  // THEN we expect p50 to be exact and p999 in the bucket of 1000
+  EXPECT_EQ(snapshot.count, 100);
+  EXPECT_EQ(snapshot.quantile(0.5), 10);
+  EXPECT_GE(snapshot.quantile(0.999), 1000);
+  EXPECT_LT(snapshot.quantile(0.999), 1064);
+}
+
+TEST(InstrumentedTests, SuccessAndErrorCounts) {
+  // GIVEN an instrumented pipeline
+  const auto pipeline = fp::instrumented(
+      "success_and_error", fp::mcompose(divide_4_by, divide_4_by));
+
+  // WHEN we call it with values that succeed and fail
+  for (auto const value : {1.0, 2.0, 0.0}) {
+    (void)pipeline(value);
+  }
+
+  // THEN we expect the calls counted separately and errors counted by code
+  const auto stats = stats_for("success_and_error");
+  EXPECT_EQ(stats.success.count, 2);
+  EXPECT_EQ(stats.error.count, 1);
+  EXPECT_EQ(stats.error_codes[static_cast<size_t>(
+                fp::ErrorCode::INVALID_ARGUMENT)],
+            1);
+}
+
+TEST(InstrumentedTests, Optional) {
+  // GIVEN an instrumented function returning an optional
+  const auto pipeline = fp::instrumented("optional", [](int value) {
+    return value > 0 ? std::optional<int>{value} : std::nullopt;
+  });
+
+  // WHEN we call it with a value that fails
+  (void)pipeline(0);
+
+  // THEN we expect the error to be counted
+  EXPECT_EQ(stats_for("optional").error.count, 1);
+}
+
+TEST(InstrumentedTests, MergesThreads) {
+  // GIVEN an instrumented pipeline
+  const auto pipeline = fp::instrumented("merges_threads", divide_4_by);
+
+  // WHEN we call it from many threads
+  auto threads = std::vector<std::thread>{};
+  for (int i = 0; i < 20; ++i) {
+    threads.emplace_back([&pipeline] {
+      for (int j = 0; j < 100; ++j) {
+        (void)pipeline(1.0);
+      }
+    });
+  }
+  for (auto& thread : threads) thread.join();
+
+  // THEN we expect the counts of all threads to be merged
+  EXPECT_EQ(stats_for("merges_threads").success.count, 2000);
+}
+
+TEST(InstrumentedTests, FormatPrometheus) {
+  // GIVEN an instrumented pipeline that has been called
+  const auto pipeline = fp::instrumented("prometheus", divide_4_by);
+  (void)pipeline(0.0);
+
+  // WHEN we format the stats in the Prometheus exposition format
+  const auto text = fp::format_stats_prometheus({stats_for("prometheus")});
+
+  // THEN we expect the error counter for the pipeline
+  EXPECT_NE(text.find("fp_pipeline_errors_total{pipeline=\"prometheus\","
+                      "code=\"InvalidArgument\"} 1"),
+            std::string::npos)
+      << text;
+}
+
+TEST(InstrumentedTests, FormatPrometheusEscapesLabels) {
+  // GIVEN statistics of a pipeline whose name has characters that must be
+  // escaped in a label value
+  auto stats = fp::PipelineStats{};
+  stats.name = "a\\b\"c\nd";
+
+  // WHEN we format them in the Prometheus exposition format
+  const auto text = fp::format_stats_prometheus({stats});
+
+  // THEN we expect the name escaped
+  EXPECT_NE(text.find("pipeline=\"a\\\\b\\\"c\\nd\""), std::string::npos)
+      << text;
+}
+
+TEST(InstrumentedTests, WriteStatsBadPath) {
+  // GIVEN a path that cannot be written
+  const auto path = "/nonexistent/stats.txt";
+
+  // WHEN we write the stats to it
+  const auto result = fp::write_pipeline_stats(path, fp::StatsFormat::TEXT);
+
+  // THEN we expect an error
+  EXPECT_FALSE(result);
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,225 @@
+// Copyright 2022 PickNik Inc
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the PickNik Inc nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "fp/all.hpp"
+#include "gtest/gtest.h"
+
+namespace {
+/// Collects the lines written by log_error
+class LogTests : public ::testing::Test {
+ protected:
+  std::mutex mutex;
+  std::vector<std::string> lines;
+
+  void SetUp() override {
+    fp::ErrorLogger::instance().reset();
+    fp::ErrorLogger::instance().set_sink([this](std::string_view line) {
+      auto const lock = std::lock_guard{mutex};
+      lines.emplace_back(line);
+    });
+  }
+
+  void TearDown() override {
+    fp::ErrorLogger::instance().flush();
+    fp::ErrorLogger::instance().set_sink([](std::string_view) {});
+    fp::set_log_policy(fp::LogPolicy{});
+  }
+
+  std::vector<std::string> written() {
+    fp::ErrorLogger::instance().flush();
+    auto const lock = std::lock_guard{mutex};
+    return lines;
+  }
+};
+
+fp::Error out_of_range(int value) {
+  return fp::OutOfRange(fmt::format("sensor value {}", value));
+}
+}  // namespace
+
+TEST_F(LogTests, WritesError) {
+  // GIVEN an error
+  const auto error = fp::NotFound("joint");
+
+  // WHEN we log it
+  fp::log_error(error);
+
+  // THEN we expect it written by the background thread
+  EXPECT_EQ(written(), std::vector<std::string>{"[Error: [NotFound] joint]"});
+}
+
+TEST_F(LogTests, TruncatesLongMessage) {
+  // GIVEN an error with a message longer than the queued copy
+  const auto error = fp::Internal(std::string(FP_LOG_MESSAGE_SIZE + 10, 'x'));
+
+  // WHEN we log it
+  fp::log_error(error);
+
+  // THEN we expect the message written up to the limit
+  EXPECT_EQ(written(),
+            std::vector<std::string>{"[Error: [Internal] " +
+                                     std::string(FP_LOG_MESSAGE_SIZE, 'x') +
+                                     "...]"});
+}
+
+TEST_F(LogTests, ThrottlesByCallSite) {
+  // GIVEN a policy of 3 lines per window
+  auto policy = fp::LogPolicy{};
+  policy.lines_per_window = 3;
+  policy.window = std::chrono::hours{1};
+  fp::set_log_policy(policy);
+
+  // WHEN the same call site fails many times with different messages
+  for (int i = 0; i < 1000; ++i) fp::log_error(out_of_range(i));
+
+  // THEN we expect only the first 3 written and the rest counted
+  EXPECT_EQ(written().size(), 3U);
+  EXPECT_EQ(fp::ErrorLogger::instance().stats().emitted, 3U);
+  EXPECT_EQ(fp::ErrorLogger::instance().stats().suppressed, 997U);
+}
+
+TEST_F(LogTests, KeysAreIndependent) {
+  // GIVEN a policy of 1 line per window
+  auto policy = fp::LogPolicy{};
+  policy.lines_per_window = 1;
+  policy.window = std::chrono::hours{1};
+  fp::set_log_policy(policy);
+
+  // WHEN two call sites fail repeatedly
+  for (int i = 0; i < 10; ++i) {
+    fp::log_error(fp::Timeout("a"));
+    fp::log_error(fp::Unavailable("b"));
+  }
+
+  // THEN we expect one line for each
+  EXPECT_EQ(written(), (std::vector<std::string>{"[Error: [Timeout] a]",
+                                                 "[Error: [Unavailable] b]"}));
+}
+
+TEST_F(LogTests, KeysByLogSite) {
+  // GIVEN a policy of 1 line per window
+  auto policy = fp::LogPolicy{};
+  policy.lines_per_window = 1;
+  policy.window = std::chrono::hours{1};
+  fp::set_log_policy(policy);
+
+  // WHEN errors created at one site are logged from two call sites
+  for (int i = 0; i < 10; ++i) {
+    fp::log_error(out_of_range(1));
+    fp::log_error(out_of_range(2));
+  }
+
+  // THEN we expect one line for each call site
+  EXPECT_EQ(written(),
+            (std::vector<std::string>{"[Error: [OutOfRange] sensor value 1]",
+                                      "[Error: [OutOfRange] sensor value 2]"}));
+}
+
+TEST_F(LogTests, ReportsSuppressedCount) {
+  // GIVEN a policy of 1 line per short window, starting at a window boundary
+  const auto window = std::chrono::milliseconds{50};
+  auto policy = fp::LogPolicy{};
+  policy.lines_per_window = 1;
+  policy.window = window;
+  fp::set_log_policy(policy);
+  const auto now = std::chrono::steady_clock::now().time_since_epoch();
+  std::this_thread::sleep_for(window - now % window +
+                              std::chrono::milliseconds{1});
+
+  // WHEN an error logged at one site repeats within a window and again
+  // after it
+  for (int i = 0; i < 6; ++i) {
+    if (i == 5) std::this_thread::sleep_for(window);
+    fp::log_error(out_of_range(1));
+  }
+
+  // THEN we expect the second line to carry the suppressed count
+  const auto lines = written();
+  ASSERT_EQ(lines.size(), 2U);
+  EXPECT_EQ(lines.at(1),
+            "[Error: [OutOfRange] sensor value 1] (4 similar errors "
+            "suppressed)");
+}
+
+TEST_F(LogTests, EvictsExpiredKeys) {
+  // GIVEN a table filled with keys logged in the previous window
+  const auto window = std::chrono::milliseconds{50};
+  auto policy = fp::LogPolicy{};
+  policy.lines_per_window = 1;
+  policy.window = window;
+  fp::set_log_policy(policy);
+  const auto now = std::chrono::steady_clock::now().time_since_epoch();
+  std::this_thread::sleep_for(window - now % window +
+                              std::chrono::milliseconds{1});
+  for (int i = 0; i < 2 * FP_LOG_TABLE_SIZE; ++i) {
+    fp::log_error(fp::NotFound(fmt::format("old {}", i), fp::SourceLocation{}));
+  }
+  std::this_thread::sleep_for(window);
+  const auto before = written().size();
+
+  // WHEN as many new keys as slots a key probes are logged
+  for (int i = 0; i < 16; ++i) {
+    fp::log_error(fp::NotFound(fmt::format("new {}", i), fp::SourceLocation{}));
+  }
+
+  // THEN we expect each of them to take the slot of an old key and be written
+  EXPECT_EQ(written().size() - before, 16U);
+}
+
+TEST_F(LogTests, ConcurrentLogging) {
+  // GIVEN a policy of 5 lines per window
+  auto policy = fp::LogPolicy{};
+  policy.lines_per_window = 5;
+  policy.window = std::chrono::hours{1};
+  fp::set_log_policy(policy);
+
+  // WHEN many threads log the same error
+  auto threads = std::vector<std::thread>{};
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([] {
+      for (int i = 0; i < 1000; ++i) fp::log_error(out_of_range(i));
+    });
+  }
+  for (auto& thread : threads) thread.join();
+
+  // THEN we expect 5 lines and every other error counted
+  EXPECT_EQ(written().size(), 5U);
+  EXPECT_EQ(fp::ErrorLogger::instance().stats().suppressed, 3995U);
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -28,8 +28,13 @@
 
 #include <cmath>
 #include <functional>
+#include <memory>
 #include <optional>
+#include <exception>
 #include <stdexcept>
+#include <string_view>
+#include <type_traits>
+#include <vector>
 
 #include "fp/all.hpp"
 #include "gtest/gtest.h"
@@ -49,6 +54,33 @@ fp::Result<double> divide_4_by(double val) {
   return 4.0 / val;
 }
 
+enum class GripError { SLIPPED, NO_OBJECT };
+
+template <>
+struct fp::ErrorDomain<GripError> {
+  static constexpr std::string_view name = "grip";
+  static constexpr fp::ErrorCode canonical(GripError code) {
+    return code == GripError::SLIPPED ? fp::ErrorCode::ABORTED
+                                      : fp::ErrorCode::NOT_FOUND;
+  }
+  static constexpr std::string_view to_string(GripError code) {
+    return code == GripError::SLIPPED ? "Slipped" : "NoObject";
+  }
+};
+
+template <>
+struct fp::ErrorConversion<fp::Error, GripError> {
+  static GripError convert(fp::Error const& error) {
+    return error.domain == GripError::SLIPPED ? GripError::SLIPPED
+                                              : GripError::NO_OBJECT;
+  }
+};
+
+fp::Result<double, GripError> grip(double force) {
+  if (force < 1.0) return tl::make_unexpected(GripError::SLIPPED);
+  return force;
+}
+
 double unsafe_divide_4_by(double val) {
   if (val == 0.0) {
     throw std::runtime_error("divide by zero");
@@ -149,6 +181,77 @@ TEST(MBindTests, MTryOkTest) {
   EXPECT_NO_THROW(fp::mtry(std::bind(&unsafe_divide_4_by, input)));
 }
 
+TEST(MBindTests, MTryVoid) {
+  // GIVEN a function returning void that throws
+  const auto f = [] { throw std::runtime_error("foo"); };
+
+  // WHEN we pass it to fp::mtry
+  const auto result = fp::mtry(f);
+
+  // THEN we get an expected<void> holding the exception
+  static_assert(std::is_same_v<decltype(result),
+                               const tl::expected<void, std::exception_ptr>>);
+  ASSERT_FALSE(result);
+  EXPECT_THROW(std::rethrow_exception(result.error()), std::runtime_error);
+}
+
+TEST(MBindTests, MTryFlattensNoexcept) {
+  // GIVEN a function that cannot throw and already returns an expected
+  using Exp = tl::expected<int, std::exception_ptr>;
+  const auto f = []() noexcept { return Exp{4}; };
+
+  // WHEN we pass it to fp::mtry
+  const auto result = fp::mtry(f);
+
+  // THEN the expected is not nested
+  static_assert(std::is_same_v<decltype(result), const Exp>);
+  ASSERT_TRUE(result);
+  EXPECT_EQ(result.value(), 4);
+}
+
+TEST(MBindTests, MBindWidensDomainError) {
+  // GIVEN a result with a compact domain error
+  const auto input = grip(0.5);
+
+  // WHEN we bind it to a function returning a Result<T> with an fp::Error
+  const auto result = input | divide_4_by;
+
+  // THEN the error is widened to an fp::Error keeping the domain code
+  static_assert(std::is_same_v<decltype(result), const fp::Result<double>>);
+  ASSERT_FALSE(result);
+  EXPECT_EQ(result.error().code, fp::ErrorCode::ABORTED);
+  EXPECT_TRUE(result.error().domain == GripError::SLIPPED);
+  EXPECT_TRUE(result.error().what.empty());
+}
+
+TEST(MBindTests, MBindNarrowsWithTrait) {
+  // GIVEN a result with an fp::Error from the grip domain
+  const auto input = fp::Result<double>{
+      tl::make_unexpected(fp::make_error(GripError::SLIPPED, "wet"))};
+
+  // WHEN we bind it to a function returning a compact domain error
+  const auto result = input | grip;
+
+  // THEN the error is narrowed with the user's ErrorConversion
+  ASSERT_FALSE(result);
+  EXPECT_EQ(result.error(), GripError::SLIPPED);
+}
+
+TEST(MBindTests, MComposeMixedErrors) {
+  // GIVEN stages with different error types composed together
+  const auto stage = fp::mcompose(grip, divide_4_by);
+
+  // WHEN we call it with a good and a bad input
+  const auto good = stage(2.0);
+  const auto bad = stage(0.1);
+
+  // THEN the value passes through both and the error is converted
+  ASSERT_TRUE(good);
+  EXPECT_EQ(good.value(), 2.0);
+  ASSERT_FALSE(bad);
+  EXPECT_TRUE(bad.error().domain == GripError::SLIPPED);
+}
+
 TEST(MBindTests, MComposeTwo) {
   // GIVEN the functions maybe_non_zero and maybe_lt_3_round and an input opt
   const auto opt = fp::make_opt(-4.0);
@@ -181,6 +284,132 @@ TEST(MBindTests, MComposeThree) {
   EXPECT_EQ(compose_result, chain_result);
 }
 
+TEST(MBindTests, MBindResultMoveOnlyChainTest) {
+  // GIVEN a move only value and a function that takes it by value
+  const auto increment =
+      [](std::unique_ptr<int> ptr) -> fp::Result<std::unique_ptr<int>> {
+    ++*ptr;
+    return ptr;
+  };
+
+  // WHEN we chain it with operator|
+  const auto result = fp::make_result(std::make_unique<int>(1)) | increment |
+                      increment;
+
+  // THEN we expect the value to have been moved through each stage
+  ASSERT_TRUE(result);
+  EXPECT_EQ(*result.value(), 3);
+}
+
+TEST(MBindTests, MBindResultReferenceTest) {
+  // GIVEN a vector and a lookup that returns a reference to an element
+  auto values = std::vector<int>{1, 2, 3};
+  const auto at = [&values](size_t index) -> fp::Result<int&> {
+    if (index >= values.size()) {
+      return tl::make_unexpected(fp::OutOfRange());
+    }
+    return values[index];
+  };
+
+  // WHEN we chain it with a function that modifies the element in place
+  const auto result = fp::make_result(size_t{1}) | at |
+                      [](int& value) -> fp::Result<int&> {
+    value *= 10;
+    return value;
+  };
+
+  // THEN we expect the result to refer to the element in the vector
+  ASSERT_TRUE(result);
+  EXPECT_EQ(&result.value(), &values[1]);
+  EXPECT_EQ(values[1], 20);
+}
+
+TEST(MBindTests, MBindResultVoidTest) {
+  // GIVEN a Result<void> and a function that takes no arguments
+  const auto result = fp::make_result();
+  const auto four = []() { return fp::make_result(4); };
+
+  // WHEN we fp::mbind it with the function
+  // THEN we expect the value of the function
+  EXPECT_EQ(fp::mbind(result, four), fp::make_result(4));
+}
+
+TEST(MBindTests, MBindResultVoidErrorTest) {
+  // GIVEN a Result<void> with an error
+  const auto result = fp::Result<void>{tl::make_unexpected(fp::Aborted())};
+  const auto four = []() { return fp::make_result(4); };
+
+  // WHEN we chain it with a function that takes no arguments
+  // THEN we expect the error
+  EXPECT_EQ((result | four).error().code, fp::ErrorCode::ABORTED);
+}
+
+TEST(MBindTests, MComposeReference) {
+  // GIVEN a function that borrows an element and a function that reads it
+  auto values = std::vector<double>{1.0, 2.0, 4.0};
+  const auto back = [](std::vector<double>& vec) -> fp::Result<double&> {
+    return vec.back();
+  };
+
+  // WHEN we compose it with divide_4_by and call it with the vector
+  const auto result = fp::mcompose(back, divide_4_by)(values);
+
+  // THEN we expect the function to have been called with the element
+  EXPECT_EQ(result, fp::make_result(1.0));
+}
+
+TEST(MBindTests, MBindOptMoveOnlyChainTest) {
+  // GIVEN a move only value and a function that takes it by value
+  const auto increment =
+      [](std::unique_ptr<int> ptr) -> std::optional<std::unique_ptr<int>> {
+    ++*ptr;
+    return ptr;
+  };
+
+  // WHEN we chain it with operator|
+  const auto opt = fp::make_opt(std::make_unique<int>(1)) | increment |
+                   increment;
+
+  // THEN we expect the value to have been moved through each stage
+  ASSERT_TRUE(opt);
+  EXPECT_EQ(**opt, 3);
+}
+
+TEST(MBindTests, MBindCompactOptTest) {
+  // GIVEN compact optional indices, one of them empty
+  using Index = fp::compact_optional<int, fp::value_sentinel<int, -1>>;
+  const auto values = std::vector<double>{1.0, 2.0, 4.0};
+  const auto lookup = [&values](int index) -> std::optional<double> {
+    if (index >= static_cast<int>(values.size())) return std::nullopt;
+    return values[index];
+  };
+
+  // WHEN we chain them with a function
+  // THEN we expect the function to be called only for the index
+  EXPECT_EQ(Index{2} | lookup, fp::make_opt(4.0));
+  EXPECT_EQ(Index{} | lookup, std::nullopt);
+  EXPECT_EQ(fp::mbind(Index{5}, lookup), std::nullopt);
+}
+
+TEST(MBindTests, MComposeCompactOpt) {
+  // GIVEN functions returning compact optional doubles
+  using Real = fp::compact_optional<double, fp::nan_sentinel<double>>;
+  const auto safe_sqrt = [](double x) -> Real {
+    return x < 0.0 ? Real{} : Real{std::sqrt(x)};
+  };
+  const auto reciprocal = [](double x) -> Real {
+    return x == 0.0 ? Real{} : Real{1.0 / x};
+  };
+
+  // WHEN we compose them
+  const auto f = fp::mcompose(safe_sqrt, reciprocal);
+
+  // THEN we expect the empty state passed through
+  EXPECT_EQ(f(4.0), Real{0.5});
+  EXPECT_FALSE(f(-4.0));
+  EXPECT_FALSE(f(0.0));
+}
+
 int main(int argc, char** argv) {
   ::testing::InitGoogleTest(&argc, argv);
   return RUN_ALL_TESTS();
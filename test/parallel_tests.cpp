@@ -0,0 +1,379 @@
+// Copyright 2022 PickNik Inc
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the PickNik Inc nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+#include "fp/all.hpp"
+#include "gtest/gtest.h"
+
+enum class MotionError { COLLISION, FAULT };
+
+template <>
+struct fp::ErrorConversion<fp::Error, MotionError> {
+  static MotionError convert(fp::Error const&) { return MotionError::FAULT; }
+};
+
+TEST(ParallelTests, WhenAllValues) {
+  // GIVEN three callables returning values of different types
+  const auto a = [] { return fp::make_result(1); };
+  const auto b = [] { return fp::make_result(std::string{"two"}); };
+  const auto c = [] { return fp::make_result(3.0); };
+
+  // WHEN we run them with when_all
+  const auto result = fp::when_all(a, b, c);
+
+  // THEN we expect a tuple of the values
+  ASSERT_TRUE(result) << fmt::format("{}", result.error());
+  EXPECT_EQ(result.value(), std::make_tuple(1, std::string{"two"}, 3.0));
+}
+
+TEST(ParallelTests, WhenAllFirstError) {
+  // GIVEN callables where the second and third fail
+  const auto a = [] { return fp::make_result(1); };
+  const auto b = []() -> fp::Result<int> {
+    return tl::make_unexpected(fp::NotFound("b"));
+  };
+  const auto c = []() -> fp::Result<int> {
+    return tl::make_unexpected(fp::Timeout("c"));
+  };
+
+  // WHEN we run them with when_all
+  const auto result = fp::when_all(a, b, c);
+
+  // THEN we expect an error from one of the failing callables
+  ASSERT_FALSE(result);
+  EXPECT_TRUE(result.error().code == fp::ErrorCode::NOT_FOUND ||
+              result.error().code == fp::ErrorCode::TIMEOUT);
+}
+
+TEST(ParallelTests, WhenAllRunsConcurrently) {
+  // GIVEN a pool with two threads and three callables that wait for each
+  // other
+  auto pool = fp::ThreadPool{2};
+  auto arrived = std::atomic<int>{0};
+  const auto barrier = [&arrived] {
+    arrived.fetch_add(1);
+    while (arrived.load() < 3) std::this_thread::yield();
+    return fp::make_result(true);
+  };
+
+  // WHEN we run them with when_all
+  auto policy = fp::WhenAllPolicy{};
+  policy.pool = &pool;
+  const auto result = fp::when_all(policy, barrier, barrier, barrier);
+
+  // THEN we expect them all to have run at the same time
+  EXPECT_TRUE(result);
+}
+
+TEST(ParallelTests, WhenAllInlineSkipsAfterError) {
+  // GIVEN a policy with little estimated work and a callable after an error
+  auto policy = fp::WhenAllPolicy{};
+  policy.estimated_work = std::chrono::nanoseconds{100};
+  auto called = false;
+  const auto fail = []() -> fp::Result<int> {
+    return tl::make_unexpected(fp::Aborted());
+  };
+  const auto after = [&called] {
+    called = true;
+    return fp::make_result(1);
+  };
+
+  // WHEN we run them with when_all
+  const auto result = fp::when_all(policy, fail, after);
+
+  // THEN we expect them to run inline and the second to be skipped
+  ASSERT_FALSE(result);
+  EXPECT_EQ(result.error().code, fp::ErrorCode::ABORTED);
+  EXPECT_FALSE(called);
+}
+
+TEST(ParallelTests, WhenAllException) {
+  // GIVEN a callable that throws
+  const auto a = [] { return fp::make_result(1); };
+  const auto b = []() -> fp::Result<int> {
+    throw std::runtime_error("oops");
+  };
+
+  // WHEN we run them with when_all
+  const auto result = fp::when_all(a, b);
+
+  // THEN we expect an Exception error
+  ASSERT_FALSE(result);
+  EXPECT_EQ(result.error().code, fp::ErrorCode::EXCEPTION);
+}
+
+TEST(ParallelTests, WhenAllCustomError) {
+  // GIVEN callables returning a custom error type, one of them failing
+  const auto a = []() -> fp::Result<int, MotionError> { return 1; };
+  const auto b = []() -> fp::Result<int, MotionError> {
+    return tl::make_unexpected(MotionError::COLLISION);
+  };
+
+  // WHEN we run them with when_all
+  const auto result = fp::when_all(a, b);
+
+  // THEN we expect the custom error
+  using Returned = std::decay_t<decltype(result)>;
+  static_assert(std::is_same_v<Returned::error_type, MotionError>);
+  ASSERT_FALSE(result);
+  EXPECT_EQ(result.error(), MotionError::COLLISION);
+}
+
+TEST(ParallelTests, WhenAllCustomErrorException) {
+  // GIVEN a callable returning a custom error type that throws
+  const auto a = []() -> fp::Result<int, MotionError> { return 1; };
+  const auto b = []() -> fp::Result<int, MotionError> {
+    throw std::runtime_error("oops");
+  };
+
+  // WHEN we run them with when_all
+  const auto result = fp::when_all(a, b);
+
+  // THEN we expect the exception converted with fp::ErrorConversion
+  ASSERT_FALSE(result);
+  EXPECT_EQ(result.error(), MotionError::FAULT);
+}
+
+TEST(ParallelTests, WhenAllVoid) {
+  // GIVEN a callable returning Result<void>
+  const auto a = [] { return fp::make_result(); };
+  const auto b = [] { return fp::make_result(2); };
+
+  // WHEN we run them with when_all
+  const auto result = fp::when_all(a, b);
+
+  // THEN we expect monostate in place of the void value
+  ASSERT_TRUE(result);
+  EXPECT_EQ(std::get<1>(result.value()), 2);
+}
+
+TEST(ParallelTests, NestedWhenAll) {
+  // GIVEN a pool with one thread and callables that call when_all
+  auto pool = fp::ThreadPool{1};
+  auto policy = fp::WhenAllPolicy{};
+  policy.pool = &pool;
+  const auto leaf = [] { return fp::make_result(1); };
+  const auto inner = [&] {
+    return fp::when_all(policy, leaf, leaf).map([](auto const& values) {
+      return std::get<0>(values) + std::get<1>(values);
+    });
+  };
+
+  // WHEN we nest when_all calls
+  const auto result = fp::when_all(policy, inner, inner, inner);
+
+  // THEN we expect them to complete without deadlocking
+  ASSERT_TRUE(result);
+  EXPECT_EQ(result.value(), std::make_tuple(2, 2, 2));
+}
+
+TEST(ParallelTests, ParValidateValid) {
+  // GIVEN a large vector of valid samples
+  const auto samples = std::vector<double>(100000, 0.5);
+  auto policy = fp::ValidatePolicy{};
+  policy.grain_size = 1000;
+
+  // WHEN we validate them in parallel
+  const auto result = fp::par_validate(
+      samples, fp::validate_range<double>{0.0, 1.0}, policy);
+
+  // THEN we expect success
+  EXPECT_TRUE(result);
+}
+
+TEST(ParallelTests, ParValidateLowestIndex) {
+  // GIVEN samples with failures late and early in the vector
+  auto samples = std::vector<double>(100000, 0.5);
+  samples.at(90000) = 2.0;
+  samples.at(30001) = -1.0;
+  samples.at(30002) = 3.0;
+  auto pool = fp::ThreadPool{3};
+  auto policy = fp::ValidatePolicy{};
+  policy.grain_size = 1000;
+  policy.pool = &pool;
+  policy.name = "sample";
+
+  for (int i = 0; i < 20; ++i) {
+    // WHEN we validate them in parallel
+    const auto result = fp::par_validate(
+        samples, fp::validate_range<double>{0.0, 1.0}, policy);
+
+    // THEN we expect the failure with the lowest index every time
+    ASSERT_FALSE(result);
+    EXPECT_EQ(result.error().code, fp::ErrorCode::OUT_OF_RANGE);
+    EXPECT_EQ(result.error().what.rfind("sample: -1", 0), 0U)
+        << result.error().what;
+    EXPECT_NE(fmt::format("{}", result.error()).find("at index 30001"),
+              std::string::npos);
+  }
+}
+
+TEST(ParallelTests, ParValidateAll) {
+  // GIVEN integers with some odd values and a validator taking one argument
+  auto values = std::vector<int>(10000, 2);
+  values.at(9999) = 3;
+  values.at(5) = 1;
+  values.at(5000) = 7;
+  const auto even = [](int value) -> fp::Result<int> {
+    if (value % 2 != 0) return tl::make_unexpected(fp::InvalidArgument());
+    return value;
+  };
+  auto policy = fp::ValidatePolicy{};
+  policy.grain_size = 100;
+
+  // WHEN we collect all failures
+  const auto failures = fp::par_validate_all(values, even, policy);
+
+  // THEN we expect them ordered by index
+  ASSERT_EQ(failures.size(), 3U);
+  EXPECT_EQ(failures.at(0).index, 5U);
+  EXPECT_EQ(failures.at(1).index, 5000U);
+  EXPECT_EQ(failures.at(2).index, 9999U);
+}
+
+TEST(ParallelTests, ReduceResultsDeterministicSum) {
+  // GIVEN many doubles whose floating point sum depends on the grouping
+  auto values = std::vector<fp::Result<double>>{};
+  for (int i = 0; i < 100000; ++i) {
+    values.push_back(1.0 / (1.0 + i) * (i % 2 == 0 ? 1e8 : 1e-8));
+  }
+  auto pool = fp::ThreadPool{3};
+  auto parallel = fp::ReducePolicy{};
+  parallel.grain_size = 1000;
+  parallel.pool = &pool;
+  auto serial = parallel;
+  serial.pool = nullptr;
+
+  // WHEN we sum them in parallel several times and on the calling thread
+  const auto expected = fp::reduce_results(values, 0.0, std::plus<>{}, serial);
+
+  // THEN every run gives the same bits and reduced every value
+  ASSERT_TRUE(expected);
+  EXPECT_EQ(expected.value().reduced, values.size());
+  for (int run = 0; run < 10; ++run) {
+    const auto sum = fp::reduce_results(values, 0.0, std::plus<>{}, parallel);
+    ASSERT_TRUE(sum);
+    EXPECT_EQ(sum.value().value, expected.value().value);
+  }
+}
+
+TEST(ParallelTests, ReduceResultsFailFast) {
+  // GIVEN values with errors at two indices
+  auto values = std::vector<fp::Result<int>>(5000, 1);
+  values[4321] = tl::make_unexpected(fp::OutOfRange("late"));
+  values[1234] = tl::make_unexpected(fp::OutOfRange("early"));
+  auto pool = fp::ThreadPool{3};
+  auto policy = fp::ReducePolicy{};
+  policy.grain_size = 100;
+  policy.pool = &pool;
+
+  // WHEN we reduce them failing fast
+  const auto result = fp::reduce_results(values, 0, std::plus<>{}, policy);
+
+  // THEN the error with the lowest index is returned with the index
+  ASSERT_FALSE(result);
+  EXPECT_EQ(result.error().what, "early");
+  EXPECT_EQ(fmt::format("{}", result.error()),
+            "[Error: [OutOfRange] early; at index 1234]");
+}
+
+TEST(ParallelTests, ReduceResultsSkipErrors) {
+  // GIVEN values where every third is an error
+  auto values = std::vector<fp::Result<int>>{};
+  for (int i = 0; i < 3000; ++i) {
+    if (i % 3 == 0) {
+      values.push_back(tl::make_unexpected(fp::DataLoss()));
+    } else {
+      values.push_back(i);
+    }
+  }
+  auto policy = fp::ReducePolicy{};
+  policy.errors = fp::ReduceErrors::SKIP;
+  policy.grain_size = 64;
+
+  // WHEN we reduce them skipping errors
+  const auto result = fp::reduce_results(values, 10, std::plus<>{}, policy);
+
+  // THEN the values are summed with init and the errors counted
+  ASSERT_TRUE(result);
+  auto expected = 10;
+  for (int i = 0; i < 3000; ++i) expected += i % 3 == 0 ? 0 : i;
+  EXPECT_EQ(result.value().value, expected);
+  EXPECT_EQ(result.value().reduced, 2000U);
+  EXPECT_EQ(result.value().skipped, 1000U);
+}
+
+TEST(ParallelTests, ReduceResultsTransformedType) {
+  // GIVEN doubles we want to count, transformed to counts first
+  const auto values =
+      std::vector<fp::Result<double>>{3.7, 2.5,
+                                      tl::make_unexpected(fp::DataLoss()), 1.0};
+  auto counts = std::vector<fp::Result<size_t>>{};
+  for (auto const& value : values) {
+    counts.push_back(value.map([](double) { return size_t{1}; }));
+  }
+  auto policy = fp::ReducePolicy{};
+  policy.errors = fp::ReduceErrors::SKIP;
+  policy.grain_size = 1;
+
+  // WHEN we reduce the counts with a size_t init
+  const auto result =
+      fp::reduce_results(counts, size_t{0}, std::plus<>{}, policy);
+
+  // THEN every value is counted once
+  ASSERT_TRUE(result);
+  EXPECT_EQ(result.value().value, 3U);
+  EXPECT_EQ(result.value().skipped, 1U);
+}
+
+TEST(ParallelTests, ReduceResultsEmpty) {
+  // GIVEN no values
+  const auto values = std::vector<fp::Result<double>>{};
+
+  // WHEN we reduce them
+  const auto result = fp::reduce_results(values, 2.5, std::plus<>{});
+
+  // THEN the result is init
+  ASSERT_TRUE(result);
+  EXPECT_EQ(result.value().value, 2.5);
+  EXPECT_EQ(result.value().reduced, 0U);
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
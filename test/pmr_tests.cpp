@@ -0,0 +1,187 @@
+// Copyright 2022 PickNik Inc
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the PickNik Inc nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <cstddef>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include "fp/all.hpp"
+#include "gtest/gtest.h"
+
+namespace {
+/// Counts the allocations passed on to the new/delete resource
+class CountingResource : public std::pmr::memory_resource {
+ public:
+  size_t allocations = 0;
+  size_t deallocations = 0;
+
+ private:
+  void* do_allocate(size_t bytes, size_t alignment) override {
+    ++allocations;
+    return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+  }
+  void do_deallocate(void* p, size_t bytes, size_t alignment) override {
+    ++deallocations;
+    std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+  }
+  bool do_is_equal(
+      std::pmr::memory_resource const& other) const noexcept override {
+    return this == &other;
+  }
+};
+
+const auto kLongMessage =
+    std::string{"a message too long for the small string optimization"};
+
+enum class GripperError { DROPPED, JAMMED };
+}  // namespace
+
+template <>
+struct fp::ErrorDomain<GripperError> {
+  static constexpr std::string_view name = "gripper";
+  static constexpr fp::ErrorCode canonical(GripperError code) {
+    return code == GripperError::DROPPED ? fp::ErrorCode::ABORTED
+                                         : fp::ErrorCode::UNAVAILABLE;
+  }
+  static constexpr std::string_view to_string(GripperError code) {
+    return code == GripperError::DROPPED ? "Dropped" : "Jammed";
+  }
+};
+
+TEST(PmrTests, MakeErrorUsesThreadResource) {
+  // GIVEN a counting resource installed on this thread
+  auto counting = CountingResource{};
+  const auto* const previous = fp::pmr::set_thread_resource(&counting);
+
+  // WHEN we make an error with a long message
+  const auto error =
+      fp::pmr::make_error(fp::ErrorCode::NOT_FOUND, kLongMessage);
+  fp::pmr::set_thread_resource(const_cast<std::pmr::memory_resource*>(
+      previous));
+
+  // THEN we expect the message allocated from the resource
+  EXPECT_EQ(error.what, kLongMessage.c_str());
+  EXPECT_EQ(counting.allocations, 1U);
+}
+
+TEST(PmrTests, MakeErrorDomain) {
+  // GIVEN a code of an error domain
+  const auto code = GripperError::JAMMED;
+
+  // WHEN we make an error from it
+  const auto error = fp::pmr::make_error(code, "finger 2");
+
+  // THEN we expect the canonical code and the domain code like fp::make_error
+  EXPECT_EQ(error.code, fp::ErrorCode::UNAVAILABLE);
+  EXPECT_TRUE(error.domain == GripperError::JAMMED);
+  EXPECT_EQ(fmt::format("{}", error),
+            fmt::format("{}", fp::make_error(code, "finger 2")));
+}
+
+TEST(PmrTests, ArenaBurst) {
+  // GIVEN an arena with a counting upstream
+  auto upstream = CountingResource{};
+  auto errors = std::vector<fp::pmr::Error>{};
+  {
+    auto arena = fp::pmr::ErrorArena{1 << 16, &upstream};
+
+    // WHEN we make a burst of errors and copies of them
+    for (int i = 0; i < 100; ++i) {
+      errors.push_back(fp::pmr::format_error(fp::ErrorCode::TIMEOUT,
+                                             "{} attempt {}", kLongMessage, i));
+    }
+    const auto copies = errors;
+
+    // THEN we expect them to come from one block of the upstream
+    EXPECT_EQ(upstream.allocations, 1U);
+    EXPECT_EQ(copies.back().what, errors.back().what);
+    errors.clear();
+  }
+
+  // THEN we expect the block freed once when the arena is destroyed
+  EXPECT_EQ(upstream.deallocations, 1U);
+}
+
+TEST(PmrTests, FormatError) {
+  // GIVEN an arena
+  auto arena = fp::pmr::ErrorArena{};
+
+  // WHEN we format an error with context
+  const auto error = fp::with_context(
+      fp::pmr::format_error(fp::ErrorCode::OUT_OF_RANGE, "{} is too big", 5),
+      "reading {}", "rate");
+
+  // THEN we expect it formatted like fp::Error
+  EXPECT_EQ(fmt::format("{}", error),
+            "[Error: [OutOfRange] 5 is too big; reading rate]");
+  EXPECT_EQ(
+      fmt::format("{}", fp::pmr::Result<int>{tl::make_unexpected(error)}),
+      "[Result<T>: [Error: [OutOfRange] 5 is too big; reading rate]]");
+}
+
+TEST(PmrTests, ToError) {
+  // GIVEN an error allocated in an arena
+  auto kept = fp::Error{};
+  {
+    auto arena = fp::pmr::ErrorArena{};
+    const auto error =
+        fp::pmr::make_error(fp::ErrorCode::ABORTED, kLongMessage);
+
+    // WHEN we convert it to fp::Error
+    kept = fp::pmr::to_error(error);
+  }
+
+  // THEN we expect it to outlive the arena
+  EXPECT_EQ(kept, fp::Aborted(kLongMessage));
+  EXPECT_EQ(fp::pmr::from_error(kept).what, kLongMessage.c_str());
+}
+
+TEST(PmrTests, BindConvertsError) {
+  // GIVEN a pmr result with an error allocated from an arena
+  auto arena = fp::pmr::ErrorArena{};
+  const auto error = fp::pmr::make_error(fp::ErrorCode::TIMEOUT, "slow");
+  const auto input = fp::pmr::Result<int>{tl::make_unexpected(error)};
+
+  // WHEN we bind it to a function returning an fp::Result
+  const auto result =
+      input | [](int value) { return fp::make_result(value * 2); };
+
+  // THEN the error is copied into an fp::Error
+  static_assert(std::is_same_v<decltype(result), const fp::Result<int>>);
+  ASSERT_FALSE(result);
+  EXPECT_EQ(result.error().code, fp::ErrorCode::TIMEOUT);
+  EXPECT_EQ(result.error().what, "slow");
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,156 @@
+// Copyright 2022 PickNik Inc
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the PickNik Inc nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <chrono>
+#include <memory>
+#include <stdexcept>
+
+#include "fp/all.hpp"
+#include "gtest/gtest.h"
+
+namespace {
+/// Clock advanced by hand
+struct FakeClock {
+  using duration = std::chrono::nanoseconds;
+  using time_point = std::chrono::time_point<FakeClock>;
+
+  std::shared_ptr<duration> current = std::make_shared<duration>(0);
+
+  time_point now() const { return time_point{*current}; }
+  void advance(duration d) const { *current += d; }
+};
+
+fp::Result<int> twice(int x) { return x * 2; }
+}  // namespace
+
+TEST(RateLimitTests, Burst) {
+  // GIVEN a limiter with a burst of 3
+  auto calls = 0;
+  const auto counted = [&calls](int x) {
+    ++calls;
+    return twice(x);
+  };
+  const auto limited = fp::rate_limit(counted, 10.0, 3,
+                                      std::chrono::nanoseconds{0}, FakeClock{});
+
+  // WHEN we call it 4 times at once
+  for (int i = 0; i < 3; ++i) {
+    EXPECT_EQ(limited(i), fp::make_result(i * 2));
+  }
+  const auto result = limited(3);
+
+  // THEN we expect the fourth call rejected without calling the function
+  EXPECT_EQ(result.error().code, fp::ErrorCode::RESOURCE_EXHAUSTED);
+  EXPECT_EQ(calls, 3);
+  EXPECT_EQ(limited.stats().accepted, 3U);
+  EXPECT_EQ(limited.stats().rejected, 1U);
+}
+
+TEST(RateLimitTests, Refill) {
+  // GIVEN an empty bucket refilled at 10 tokens per second
+  const auto clock = FakeClock{};
+  const auto limited =
+      fp::rate_limit(twice, 10.0, 1, std::chrono::nanoseconds{0}, clock);
+  ASSERT_TRUE(limited(1));
+  ASSERT_FALSE(limited(1));
+
+  // WHEN 100ms pass
+  clock.advance(std::chrono::milliseconds{100});
+
+  // THEN we expect one more call to be allowed
+  EXPECT_TRUE(limited(1));
+  EXPECT_FALSE(limited(1));
+}
+
+TEST(RateLimitTests, Pipeline) {
+  // GIVEN a rate limited stage in a composed pipeline
+  const auto limited = fp::rate_limit(twice, 1.0, 1);
+  const auto pipeline = fp::mcompose(twice, limited);
+
+  // WHEN we call it twice
+  const auto first = pipeline(1);
+  const auto second = pipeline(1);
+
+  // THEN we expect the second call to be shed
+  EXPECT_EQ(first, fp::make_result(4));
+  EXPECT_EQ(second.error().code, fp::ErrorCode::RESOURCE_EXHAUSTED);
+}
+
+TEST(RateLimitTests, Blocking) {
+  // GIVEN a limiter of 100 calls per second that waits up to 50ms
+  const auto limited =
+      fp::rate_limit(twice, 100.0, 1, std::chrono::milliseconds{50});
+
+  // WHEN we call it twice
+  const auto begin = std::chrono::steady_clock::now();
+  const auto first = limited(1);
+  const auto second = limited(2);
+  const auto elapsed = std::chrono::steady_clock::now() - begin;
+
+  // THEN we expect the second call to wait for a token
+  EXPECT_TRUE(first);
+  EXPECT_EQ(second, fp::make_result(4));
+  EXPECT_GE(elapsed, std::chrono::milliseconds{5});
+}
+
+TEST(RateLimitTests, BlockingDeadline) {
+  // GIVEN a limiter of 1 call per second that waits up to 1ms
+  const auto limited =
+      fp::rate_limit(twice, 1.0, 1, std::chrono::milliseconds{1});
+
+  // WHEN we call it twice
+  (void)limited(1);
+  const auto second = limited(2);
+
+  // THEN we expect the second call rejected since no token comes in time
+  EXPECT_EQ(second.error().code, fp::ErrorCode::RESOURCE_EXHAUSTED);
+}
+
+TEST(RateLimitTests, InvalidRate) {
+  // GIVEN rates that are not positive
+  // WHEN we make limiters with them
+  // THEN we expect invalid_argument
+  EXPECT_THROW((void)fp::rate_limit(twice, 0.0, 1), std::invalid_argument);
+  EXPECT_THROW((void)fp::rate_limit(twice, -5.0, 1), std::invalid_argument);
+}
+
+TEST(RateLimitTests, HighRateStillLimits) {
+  // GIVEN a rate above one token per nanosecond and a burst of 1
+  const auto limited =
+      fp::rate_limit(twice, 1e12, 1, std::chrono::nanoseconds{0}, FakeClock{});
+
+  // WHEN we call it twice at the same time
+  // THEN we expect the second call rejected
+  EXPECT_TRUE(limited(1));
+  EXPECT_FALSE(limited(1));
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -26,9 +26,35 @@
 // ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
 // POSSIBILITY OF SUCH DAMAGE.
 
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
 #include "fp/all.hpp"
 #include "gtest/gtest.h"
 
+namespace {
+enum class IkError { NO_SOLUTION, JOINT_LIMIT };
+}  // namespace
+
+template <>
+struct fp::ErrorDomain<IkError> {
+  static constexpr std::string_view name = "ik";
+  static constexpr fp::ErrorCode canonical(IkError code) {
+    return code == IkError::NO_SOLUTION ? fp::ErrorCode::NOT_FOUND
+                                        : fp::ErrorCode::OUT_OF_RANGE;
+  }
+  static constexpr std::string_view to_string(IkError code) {
+    return code == IkError::NO_SOLUTION ? "NoSolution" : "JointLimit";
+  }
+};
+
 TEST(ResultTests, CancelledErrorFalse) {
   // GIVEN Cancelled error
   const auto error = fp::Cancelled();
@@ -271,6 +297,237 @@ TEST(ResultTests, MaybeError) {
   EXPECT_EQ(error.value().code, fp::ErrorCode::UNKNOWN);
 }
 
+TEST(ResultTests, MaybeErrorVoidAndReference) {
+  // GIVEN a Result<void> and a Result<T&> with an error
+  const auto value = 6.5;
+  const auto a = fp::make_result(std::ref(value));
+  const fp::Result<void> b = tl::make_unexpected(fp::NotFound());
+
+  // WHEN we call maybe_error on those results
+  const auto error = fp::maybe_error(a, b);
+
+  // THEN we expect it to have the NotFound error
+  ASSERT_TRUE(error);
+  EXPECT_EQ(error.value().code, fp::ErrorCode::NOT_FOUND);
+}
+
+TEST(ResultTests, MakeResultReference) {
+  // GIVEN a value
+  auto value = std::string{"foo"};
+
+  // WHEN we make a result from a reference to it
+  const auto result = fp::make_result<std::string&>(value);
+
+  // THEN we expect the result to refer to the value without a copy
+  ASSERT_TRUE(result);
+  EXPECT_EQ(&result.value(), &value);
+  EXPECT_EQ(result->size(), 3);
+}
+
+TEST(ResultTests, FormatResultReference) {
+  // GIVEN a Result<T&>
+  const auto value = 4;
+  const auto result = fp::make_result(std::cref(value));
+
+  // WHEN we call fmt::format on it
+  // THEN we expect it to format the referenced value
+  EXPECT_EQ(fmt::format("{}", result), "[Result<T>: value=4]");
+}
+
+TEST(ResultTests, FormatResultVoid) {
+  // GIVEN a Result<void> with and without an error
+  const auto result = fp::make_result();
+  const fp::Result<void> error = tl::make_unexpected(fp::DataLoss("foo"));
+
+  // WHEN we call fmt::format on them
+  // THEN we expect it to format
+  EXPECT_EQ(fmt::format("{}", result), "[Result<T>: void]");
+  EXPECT_EQ(fmt::format("{}", error),
+            "[Result<T>: [Error: [DataLoss] foo]]");
+}
+
+TEST(ResultTests, ErrorContextFormat) {
+  // GIVEN an error with two frames of context
+  const auto error = fp::with_context(
+      fp::with_context(fp::NotFound("joint"), "parsing joint {}", 3),
+      "loading {} from {}", "config", "disk");
+
+  // WHEN we format it
+  // THEN we expect the context after the message, innermost first
+  EXPECT_EQ(fmt::format("{}", error),
+            "[Error: [NotFound] joint; parsing joint 3; loading config from "
+            "disk]");
+}
+
+TEST(ResultTests, ErrorContextLocation) {
+  // GIVEN an error with context
+  const auto error = fp::with_context(fp::Internal(), "context");
+
+  // WHEN we format it with the location
+  const auto formatted = fmt::format("{:l}", error);
+
+  // THEN we expect the file the context was added in
+  EXPECT_NE(formatted.find("result_tests.cpp:"), std::string::npos)
+      << formatted;
+}
+
+TEST(ResultTests, ErrorContextMapError) {
+  // GIVEN a Result with an error
+  const fp::Result<int> result = tl::make_unexpected(fp::Timeout("io"));
+
+  // WHEN we add context with map_error
+  const auto with_context =
+      result.map_error(fp::add_context("reading {} bytes", 16));
+
+  // THEN we expect the context in the error but not in equality
+  EXPECT_EQ(fmt::format("{}", with_context.error()),
+            "[Error: [Timeout] io; reading 16 bytes]");
+  EXPECT_EQ(with_context, result);
+}
+
+TEST(ResultTests, ErrorContextCopiesShareFrames) {
+  // GIVEN an error with context
+  const auto error = fp::with_context(fp::Aborted(), "first");
+
+  // WHEN we copy it and add context to the copy
+  const auto copy = fp::with_context(error, "second");
+
+  // THEN we expect the original to be unchanged and the frame to be shared
+  EXPECT_EQ(fmt::format("{}", error), "[Error: [Aborted] ; first]");
+  EXPECT_EQ(fmt::format("{}", copy), "[Error: [Aborted] ; first; second]");
+  EXPECT_EQ(copy.context.head()->next, error.context.head());
+}
+
+TEST(ResultTests, ErrorContextAcrossThreads) {
+  // GIVEN errors with context created on another thread
+  auto errors = std::vector<fp::Error>{};
+  std::thread([&errors] {
+    for (int i = 0; i < 100; ++i) {
+      errors.push_back(fp::with_context(fp::Unknown(), "frame {}", i));
+    }
+  }).join();
+
+  // WHEN we format and release them on this thread
+  const auto formatted = fmt::format("{}", errors.back());
+  errors.clear();
+
+  // THEN we expect the context to have outlived the thread
+  EXPECT_EQ(formatted, "[Error: [Unknown] ; frame 99]");
+}
+
+TEST(ResultTests, ErrorContextReleasedOnOtherThreadIsReused) {
+  // GIVEN a thread that destroys the errors this thread creates
+  auto mutex = std::mutex{};
+  auto ready = std::condition_variable{};
+  auto batch = std::vector<fp::Error>{};
+  auto done = false;
+  auto consumer = std::thread([&] {
+    auto lock = std::unique_lock{mutex};
+    while (!done) {
+      ready.wait(lock, [&] { return done || !batch.empty(); });
+      batch.clear();
+      ready.notify_all();
+    }
+  });
+  const auto send_batches = [&](int count) {
+    for (int round = 0; round < count; ++round) {
+      auto errors = std::vector<fp::Error>{};
+      for (int i = 0; i < 1000; ++i) {
+        errors.push_back(fp::with_context(fp::Unknown(), "frame {}", i));
+      }
+      auto lock = std::unique_lock{mutex};
+      batch = std::move(errors);
+      ready.notify_all();
+      ready.wait(lock, [&] { return batch.empty(); });
+    }
+  };
+
+  // WHEN many batches are handed over after the pool is warm
+  send_batches(10);
+  const auto warm = fp::ContextPool::allocated();
+  send_batches(100);
+  {
+    auto const lock = std::lock_guard{mutex};
+    done = true;
+  }
+  ready.notify_all();
+  consumer.join();
+
+  // THEN we expect the released frames to be reused instead of allocating
+  EXPECT_EQ(fp::ContextPool::allocated(), warm);
+}
+
+TEST(ResultTests, ErrorFactoryLocation) {
+  // GIVEN an error from a factory
+  const auto error = fp::OutOfRange("foo");
+
+  // WHEN we format it with and without the location
+  const auto with_location = fmt::format("{:l}", error);
+  const auto without_location = fmt::format("{}", error);
+
+  // THEN we expect the location of the call only when asked for
+  EXPECT_EQ(error.location.line(), __LINE__ - 7);
+  EXPECT_NE(with_location.find("result_tests.cpp:"), std::string::npos)
+      << with_location;
+  EXPECT_EQ(without_location, "[Error: [OutOfRange] foo]");
+}
+
+TEST(ResultTests, BacktraceOffByDefault) {
+  // GIVEN the default backtrace policy
+  // WHEN we create an Internal error
+  const auto error = fp::Internal();
+
+  // THEN we expect no backtrace
+  EXPECT_FALSE(error.backtrace);
+}
+
+TEST(ResultTests, BacktraceSelectedCodes) {
+  // GIVEN a policy capturing every Internal and Exception error
+  fp::set_backtrace_policy(1);
+
+  // WHEN we create an Internal and an Unknown error
+  const auto internal = fp::Internal();
+  const auto unknown = fp::Unknown();
+  fp::set_backtrace_policy(0);
+
+  // THEN we expect only the Internal error to have a backtrace
+  ASSERT_TRUE(internal.backtrace);
+  EXPECT_GT(internal.backtrace->size, 0);
+  EXPECT_FALSE(unknown.backtrace);
+}
+
+TEST(ResultTests, BacktraceSampled) {
+  // GIVEN a policy capturing 1 in 4 Timeout errors
+  fp::set_backtrace_policy(4, {fp::ErrorCode::TIMEOUT});
+
+  // WHEN we create 100 Timeout errors
+  int captured = 0;
+  for (int i = 0; i < 100; ++i) {
+    captured += fp::Timeout().backtrace ? 1 : 0;
+  }
+  fp::set_backtrace_policy(0);
+
+  // THEN we expect 25 of them to have a backtrace
+  EXPECT_EQ(captured, 25);
+}
+
+TEST(ResultTests, BacktraceFormat) {
+  // GIVEN an Exception error from try_to_result with a backtrace
+  fp::set_backtrace_policy(1);
+  const auto result =
+      fp::try_to_result([]() -> int { throw std::runtime_error("foo"); });
+  fp::set_backtrace_policy(0);
+  ASSERT_FALSE(result);
+
+  // WHEN we format it with and without the backtrace
+  const auto with_backtrace = fmt::format("{:b}", result.error());
+  const auto without_backtrace = fmt::format("{}", result.error());
+
+  // THEN we expect the frames only when asked for
+  EXPECT_NE(with_backtrace.find("#0 "), std::string::npos) << with_backtrace;
+  EXPECT_EQ(without_backtrace.find("#0 "), std::string::npos);
+}
+
 TEST(ResultTests, TryToResultError) {
   // GIVEN function that throws an exception
   const auto f = [] {
@@ -299,6 +556,163 @@ TEST(ResultTests, TryToResultValue) {
   EXPECT_EQ(result.value(), f()) << fmt::format("{}", result);
 }
 
+TEST(ResultTests, DomainErrorCanonicalCode) {
+  // GIVEN an error made from a domain code
+  const auto error = fp::make_error(IkError::JOINT_LIMIT, "joint 3");
+
+  // WHEN we read the codes
+  // THEN the code is the canonical one and the domain code compares equal
+  EXPECT_EQ(error.code, fp::ErrorCode::OUT_OF_RANGE);
+  EXPECT_TRUE(error.domain == IkError::JOINT_LIMIT);
+  EXPECT_TRUE(error.domain != IkError::NO_SOLUTION);
+  EXPECT_TRUE(fp::in_domain<IkError>(error.domain));
+  EXPECT_FALSE(fp::OutOfRange("joint 3").domain);
+}
+
+TEST(ResultTests, DomainCodeTriviallyCopyable) {
+  // GIVEN a domain code
+  constexpr auto code = fp::domain_code(IkError::NO_SOLUTION);
+
+  // WHEN we read it at compile time
+  // THEN the domain ID and value are known and it is trivially copyable
+  static_assert(code.domain() == fp::domain_info<IkError>.id);
+  static_assert(code.value() == 0);
+  static_assert(std::is_trivially_copyable_v<decltype(code)>);
+  EXPECT_EQ(code.info->name, "ik");
+}
+
+TEST(ResultTests, DomainErrorFormat) {
+  // GIVEN an error made from a domain code
+  const auto error = fp::make_error(IkError::NO_SOLUTION, "pose 7");
+
+  // WHEN we format it
+  // THEN the domain and code are written after the canonical code
+  EXPECT_EQ(fmt::format("{}", error),
+            "[Error: [NotFound/ik.NoSolution] pose 7]");
+}
+
+TEST(ResultTests, TryToResultVoid) {
+  // GIVEN a function that returns nothing and one that throws
+  auto calls = 0;
+  const auto f = [&calls] { ++calls; };
+  const auto g = [] { throw std::runtime_error("foo"); };
+
+  // WHEN I lift them with try_to_result
+  const auto ok = fp::try_to_result(f);
+  const auto failed = fp::try_to_result(g);
+
+  // THEN I get a Result<void>
+  static_assert(std::is_same_v<decltype(ok), const fp::Result<void>>);
+  EXPECT_TRUE(ok) << fmt::format("{}", ok);
+  EXPECT_EQ(calls, 1);
+  ASSERT_FALSE(failed);
+  EXPECT_EQ(failed.error().code, fp::ErrorCode::EXCEPTION);
+}
+
+TEST(ResultTests, TryToResultFlattens) {
+  // GIVEN a function that returns a Result<int> and may throw
+  auto fail = false;
+  const auto f = [&fail]() -> fp::Result<int> {
+    if (fail) return tl::make_unexpected(fp::NotFound("none"));
+    return 3;
+  };
+
+  // WHEN I lift it with try_to_result
+  const auto value = fp::try_to_result(f);
+  fail = true;
+  const auto error = fp::try_to_result(f);
+
+  // THEN the result is not nested and keeps the function's error
+  static_assert(std::is_same_v<decltype(value), const fp::Result<int>>);
+  ASSERT_TRUE(value) << fmt::format("{}", value);
+  EXPECT_EQ(value.value(), 3);
+  ASSERT_FALSE(error);
+  EXPECT_EQ(error.error(), fp::NotFound("none"));
+}
+
+TEST(ResultTests, TryToResultNoexcept) {
+  // GIVEN a function that cannot throw
+  const auto f = []() noexcept { return std::string{"bar"}; };
+
+  // WHEN I lift it with try_to_result
+  const auto result = fp::try_to_result(f);
+
+  // THEN it is called without a try/catch and I get its value
+  static_assert(fp::detail::is_nothrow_into_v<fp::Result<std::string>,
+                                              decltype(f)>);
+  ASSERT_TRUE(result) << fmt::format("{}", result);
+  EXPECT_EQ(result.value(), "bar");
+}
+
+TEST(ResultTests, ZipValues) {
+  // GIVEN results with values, one of them an rvalue
+  const auto a = fp::make_result(1);
+  auto b = fp::make_result(std::string{"two"});
+
+  // WHEN we zip them
+  const auto zipped = fp::zip(a, std::move(b), fp::make_result(3.0));
+
+  // THEN we get a tuple of the values
+  static_assert(
+      std::is_same_v<decltype(zipped),
+                     const fp::Result<std::tuple<int, std::string, double>>>);
+  ASSERT_TRUE(zipped);
+  EXPECT_EQ(zipped.value(), std::make_tuple(1, std::string{"two"}, 3.0));
+}
+
+TEST(ResultTests, ZipFirstError) {
+  // GIVEN results where the second and third failed
+  const auto a = fp::make_result(1);
+  const auto b = fp::Result<int>{tl::make_unexpected(fp::NotFound("b"))};
+  const auto c = fp::Result<int>{tl::make_unexpected(fp::Timeout("c"))};
+
+  // WHEN we zip them, and zip them accumulating errors
+  const auto first = fp::zip(a, b, c);
+  const auto all = fp::zip_all(a, b, c);
+
+  // THEN we get the first error, or all of them in order
+  ASSERT_FALSE(first);
+  EXPECT_EQ(first.error(), fp::NotFound("b"));
+  ASSERT_FALSE(all);
+  EXPECT_EQ(all.error(), (std::vector{fp::NotFound("b"), fp::Timeout("c")}));
+}
+
+TEST(ResultTests, ApplyMovesValues) {
+  // GIVEN a move only value in a result
+  auto ptr = fp::make_result(std::make_unique<int>(4));
+  const auto scale = fp::make_result(2);
+
+  // WHEN we apply a function to the values
+  const auto result =
+      fp::apply([](std::unique_ptr<int> p, int s) { return *p * s; },
+                std::move(ptr), scale);
+
+  // THEN the value is moved into the function
+  ASSERT_TRUE(result) << fmt::format("{}", result);
+  EXPECT_EQ(result.value(), 8);
+}
+
+TEST(ResultTests, ApplyFlattensAndAccumulates) {
+  // GIVEN a function returning a Result and inputs that failed
+  const auto divide = [](int a, int b) -> fp::Result<int> {
+    if (b == 0) return tl::make_unexpected(fp::InvalidArgument("zero"));
+    return a / b;
+  };
+  const auto bad = fp::Result<int>{tl::make_unexpected(fp::DataLoss("x"))};
+
+  // WHEN we apply it
+  const auto value = fp::apply(divide, fp::make_result(6), fp::make_result(3));
+  const auto error = fp::apply(divide, fp::make_result(6), fp::make_result(0));
+  const auto all = fp::apply_all(divide, bad, bad);
+
+  // THEN its Result is not nested and all input errors are collected
+  static_assert(std::is_same_v<decltype(value), const fp::Result<int>>);
+  EXPECT_EQ(value.value(), 2);
+  EXPECT_EQ(error.error(), fp::InvalidArgument("zero"));
+  ASSERT_FALSE(all);
+  EXPECT_EQ(all.error().size(), 2U);
+}
+
 int main(int argc, char** argv) {
   ::testing::InitGoogleTest(&argc, argv);
   return RUN_ALL_TESTS();
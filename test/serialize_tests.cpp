@@ -0,0 +1,231 @@
+// Copyright 2022 PickNik Inc
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the PickNik Inc nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "fp/all.hpp"
+#include "gtest/gtest.h"
+
+std::string to_bytes(fp::Error const& error) {
+  auto bytes = std::string{};
+  fp::serialize([&](std::string_view data) { bytes.append(data); }, error);
+  return bytes;
+}
+
+template <typename T>
+std::string to_bytes(fp::Result<T> const& result) {
+  auto bytes = std::string{};
+  fp::serialize([&](std::string_view data) { bytes.append(data); }, result);
+  return bytes;
+}
+
+struct Point {
+  double x;
+  double y;
+};
+
+TEST(SerializeTests, ErrorEncoding) {
+  // GIVEN an error
+  const auto error = fp::OutOfRange("foo");
+
+  // WHEN we serialize it
+  const auto bytes = to_bytes(error);
+
+  // THEN we expect the version, code, size and message
+  EXPECT_EQ(bytes, std::string("\x01\x0a\x03" "foo"));
+  EXPECT_EQ(bytes.size(), fp::serialized_size(error));
+}
+
+TEST(SerializeTests, ErrorRoundTrip) {
+  // GIVEN a serialized error with a long message
+  const auto error = fp::DataLoss(std::string(300, 'x'));
+  const auto bytes = to_bytes(error);
+
+  // WHEN we deserialize it
+  auto reader = fp::Reader{bytes};
+  const auto result = fp::deserialize_error(reader);
+
+  // THEN we expect the same error and every byte consumed
+  ASSERT_TRUE(result) << fmt::format("{}", result.error());
+  EXPECT_EQ(result.value(), error);
+  EXPECT_EQ(reader.offset(), bytes.size());
+}
+
+TEST(SerializeTests, ErrorViewZeroCopy) {
+  // GIVEN a serialized error
+  const auto bytes = to_bytes(fp::NotFound("foo"));
+
+  // WHEN we read it as a view
+  auto reader = fp::Reader{bytes};
+  const auto view = fp::deserialize_error_view(reader);
+
+  // THEN we expect the message to point into the buffer
+  ASSERT_TRUE(view);
+  EXPECT_EQ(view->code, fp::ErrorCode::NOT_FOUND);
+  EXPECT_EQ(view->what, "foo");
+  EXPECT_EQ(view->what.data(), bytes.data() + 3);
+}
+
+TEST(SerializeTests, TruncatedIsDataLoss) {
+  // GIVEN a serialized error missing its last byte
+  auto bytes = to_bytes(fp::NotFound("foo"));
+  bytes.pop_back();
+
+  // WHEN we deserialize it
+  auto reader = fp::Reader{bytes};
+  const auto result = fp::deserialize_error(reader);
+
+  // THEN we expect a DataLoss error
+  ASSERT_FALSE(result);
+  EXPECT_EQ(result.error().code, fp::ErrorCode::DATA_LOSS);
+}
+
+TEST(SerializeTests, WrongVersionIsDataLoss) {
+  // GIVEN a serialized error with an unknown version
+  auto bytes = to_bytes(fp::NotFound("foo"));
+  bytes[0] = 42;
+
+  // WHEN we deserialize it
+  auto reader = fp::Reader{bytes};
+  const auto result = fp::deserialize_error(reader);
+
+  // THEN we expect a DataLoss error
+  ASSERT_FALSE(result);
+  EXPECT_EQ(result.error().code, fp::ErrorCode::DATA_LOSS);
+}
+
+TEST(SerializeTests, VarintOverflowIsDataLoss) {
+  // GIVEN a 10 byte varint whose last byte has bits above the 64th
+  const auto bytes = std::string(9, '\xff') + '\x02';
+
+  // WHEN we read it
+  auto reader = fp::Reader{bytes};
+  const auto result = reader.varint();
+
+  // THEN we expect a DataLoss error
+  ASSERT_FALSE(result);
+  EXPECT_EQ(result.error().code, fp::ErrorCode::DATA_LOSS);
+}
+
+TEST(SerializeTests, VarintMaxRoundTrip) {
+  // GIVEN the largest 64 bit value written as a varint
+  auto bytes = std::string{};
+  fp::write_varint([&bytes](std::string_view in) { bytes += in; }, UINT64_MAX);
+
+  // WHEN we read it
+  auto reader = fp::Reader{bytes};
+  const auto result = reader.varint();
+
+  // THEN we expect the value
+  ASSERT_TRUE(result);
+  EXPECT_EQ(result.value(), UINT64_MAX);
+}
+
+TEST(SerializeTests, ResultTriviallyCopyableRoundTrip) {
+  // GIVEN a serialized Result<Point>
+  const auto result = fp::make_result(Point{1.5, -2.0});
+  const auto bytes = to_bytes(result);
+
+  // WHEN we deserialize it
+  auto reader = fp::Reader{bytes};
+  const auto read = fp::deserialize_result<Point>(reader);
+
+  // THEN we expect the same value
+  ASSERT_TRUE(read);
+  ASSERT_TRUE(read.value());
+  EXPECT_EQ(read.value()->x, 1.5);
+  EXPECT_EQ(read.value()->y, -2.0);
+  EXPECT_EQ(bytes.size(), fp::serialized_size(result));
+}
+
+TEST(SerializeTests, ResultErrorRoundTrip) {
+  // GIVEN a serialized Result<std::string> with an error
+  const fp::Result<std::string> result =
+      tl::make_unexpected(fp::Timeout("bar"));
+  const auto bytes = to_bytes(result);
+
+  // WHEN we deserialize it
+  auto reader = fp::Reader{bytes};
+  const auto read = fp::deserialize_result<std::string>(reader);
+
+  // THEN we expect the same error
+  ASSERT_TRUE(read);
+  EXPECT_EQ(read.value(), result);
+}
+
+TEST(SerializeTests, ResultStringAndVoidRoundTrip) {
+  // GIVEN a Result<std::string> and a Result<void> in one buffer
+  const auto bytes = to_bytes(fp::make_result(std::string{"baz"})) +
+                     to_bytes(fp::make_result());
+
+  // WHEN we deserialize them in order
+  auto reader = fp::Reader{bytes};
+  const auto first = fp::deserialize_result<std::string>(reader);
+  const auto second = fp::deserialize_result<void>(reader);
+
+  // THEN we expect both values
+  ASSERT_TRUE(first);
+  EXPECT_EQ(first.value(), fp::make_result(std::string{"baz"}));
+  ASSERT_TRUE(second);
+  EXPECT_TRUE(second.value());
+  EXPECT_TRUE(reader.remaining().empty());
+}
+
+TEST(SerializeTests, SerializeToBuffer) {
+  // GIVEN a buffer and a result
+  char buffer[16];
+  const auto result = fp::make_result(uint32_t{7});
+
+  // WHEN we serialize into the buffer and into one that is too small
+  const auto written = fp::serialize_to(result, buffer, sizeof(buffer));
+  const auto too_small = fp::serialize_to(result, buffer, 3);
+
+  // THEN we expect the size written and a ResourceExhausted error
+  ASSERT_TRUE(written);
+  EXPECT_EQ(written.value(), 6);
+  ASSERT_FALSE(too_small);
+  EXPECT_EQ(too_small.error().code, fp::ErrorCode::RESOURCE_EXHAUSTED);
+}
+
+TEST(SerializeTests, VarintSize) {
+  // GIVEN values at the boundaries of varint sizes
+  // WHEN we compute their encoded size
+  // THEN we expect 7 bits per byte
+  EXPECT_EQ(fp::varint_size(0), 1);
+  EXPECT_EQ(fp::varint_size(127), 1);
+  EXPECT_EQ(fp::varint_size(128), 2);
+  EXPECT_EQ(fp::varint_size(UINT64_MAX), 10);
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
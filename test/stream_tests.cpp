@@ -0,0 +1,188 @@
+// Copyright 2022 PickNik Inc
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the PickNik Inc nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "fp/all.hpp"
+#include "gtest/gtest.h"
+
+namespace {
+fp::Result<int> parse_int(std::string_view record) {
+  auto value = 0;
+  for (auto const c : record) {
+    if (c < '0' || c > '9') {
+      return tl::make_unexpected(
+          fp::InvalidArgument(fmt::format("not a number: {}", record)));
+    }
+    value = value * 10 + (c - '0');
+  }
+  return value;
+}
+
+std::string numbers(int count) {
+  auto data = std::string{};
+  for (int i = 0; i < count; ++i) {
+    data += std::to_string(i);
+    data += '\n';
+  }
+  return data;
+}
+}  // namespace
+
+TEST(StreamTests, ForEachRecord) {
+  // GIVEN data with a blank line, CRLF and no trailing newline
+  const auto data = std::string_view{"a\r\n\nbc\nd"};
+
+  // WHEN we split it into records
+  auto records = std::vector<std::pair<std::string_view, size_t>>{};
+  const auto delimiters = fp::stream::for_each_record(
+      data, [&](std::string_view record, fp::stream::RecordLocation location) {
+        records.emplace_back(record, location.line);
+        return true;
+      });
+
+  // THEN we expect the non-empty records with their line numbers
+  EXPECT_EQ(delimiters, 3U);
+  EXPECT_EQ(records, (std::vector<std::pair<std::string_view, size_t>>{
+                         {"a", 1}, {"bc", 3}, {"d", 4}}));
+}
+
+TEST(StreamTests, ParseRecordsInChunks) {
+  // GIVEN many records and a small chunk size
+  const auto data = numbers(1000);
+  auto pool = fp::ThreadPool{2};
+  auto options = fp::stream::Options{};
+  options.chunk_size = 64;
+  options.pool = &pool;
+
+  // WHEN we parse them
+  const auto result = fp::stream::parse_records(data, parse_int, options);
+
+  // THEN we expect all values in order
+  ASSERT_TRUE(result) << fmt::format("{}", result.error());
+  ASSERT_EQ(result.value().size(), 1000U);
+  for (int i = 0; i < 1000; ++i) {
+    EXPECT_EQ(result.value().at(i), i);
+  }
+}
+
+TEST(StreamTests, ParseRecordsFirstError) {
+  // GIVEN records with two invalid ones in different chunks
+  auto data = numbers(500);
+  data.replace(data.find("\n120\n") + 1, 3, "1x0");
+  data.replace(data.find("\n400\n") + 1, 3, "4x0");
+  auto options = fp::stream::Options{};
+  options.chunk_size = 32;
+
+  // WHEN we parse them
+  const auto result = fp::stream::parse_records(data, parse_int, options);
+
+  // THEN we expect the first error with its offset and line
+  ASSERT_FALSE(result);
+  EXPECT_EQ(result.error().code, fp::ErrorCode::INVALID_ARGUMENT);
+  EXPECT_EQ(result.error().what, "not a number: 1x0");
+  const auto offset = data.find("1x0");
+  EXPECT_NE(fmt::format("{}", result.error())
+                .find(fmt::format("record at byte {} line 121", offset)),
+            std::string::npos)
+      << fmt::format("{}", result.error());
+}
+
+TEST(StreamTests, ParseRecordsValidate) {
+  // GIVEN a pipeline parsing and validating each record
+  const auto data = std::string{"1\n5\n12\n"};
+  const auto validate = [](int value) {
+    return fp::validate_range<int>{0, 10}(value, "value");
+  };
+  const auto pipeline = [&](std::string_view record) {
+    return parse_int(record).and_then(validate);
+  };
+
+  // WHEN we parse the records
+  const auto result = fp::stream::parse_records(data, pipeline);
+
+  // THEN we expect the validation error of the third record
+  ASSERT_FALSE(result);
+  EXPECT_EQ(result.error().code, fp::ErrorCode::OUT_OF_RANGE);
+  EXPECT_NE(fmt::format("{}", result.error()).find("byte 4 line 3"),
+            std::string::npos);
+}
+
+TEST(StreamTests, ParseFile) {
+  // GIVEN a file of records
+  const auto path = std::string{"/tmp/fp_stream_tests.txt"};
+  const auto data = numbers(100);
+  auto* file = std::fopen(path.c_str(), "w");
+  ASSERT_NE(file, nullptr);
+  std::fwrite(data.data(), 1, data.size(), file);
+  std::fclose(file);
+
+  // WHEN we parse the file
+  const auto result = fp::stream::parse_file(path, parse_int);
+  std::remove(path.c_str());
+
+  // THEN we expect the values
+  ASSERT_TRUE(result) << fmt::format("{}", result.error());
+  EXPECT_EQ(result.value().size(), 100U);
+  EXPECT_EQ(result.value().back(), 99);
+}
+
+TEST(StreamTests, ParseFileNotFound) {
+  // GIVEN a path that does not exist
+  const auto path = std::string{"/tmp/fp_stream_tests_missing.txt"};
+
+  // WHEN we parse the file
+  const auto result = fp::stream::parse_file(path, parse_int);
+
+  // THEN we expect a NotFound error
+  ASSERT_FALSE(result);
+  EXPECT_EQ(result.error().code, fp::ErrorCode::NOT_FOUND);
+}
+
+TEST(StreamTests, MapEmptyFile) {
+  // GIVEN an empty file
+  const auto path = std::string{"/tmp/fp_stream_tests_empty.txt"};
+  std::fclose(std::fopen(path.c_str(), "w"));
+
+  // WHEN we map it
+  const auto mapped = fp::stream::MappedFile::open(path);
+  std::remove(path.c_str());
+
+  // THEN we expect no data
+  ASSERT_TRUE(mapped);
+  EXPECT_TRUE(mapped.value().data().empty());
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,163 @@
+// Copyright 2022 PickNik Inc
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the PickNik Inc nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "fp/all.hpp"
+#include "gtest/gtest.h"
+
+fp::Result<double> divide_4_by(double val) {
+  if (val == 0) {
+    return tl::make_unexpected(fp::InvalidArgument());
+  }
+  return 4.0 / val;
+}
+
+size_t count_records() {
+  size_t count = 0;
+  for (auto const& [tid, records] : fp::trace::records()) {
+    count += records.size();
+  }
+  return count;
+}
+
+TEST(TraceTests, RecordsEachStage) {
+  // GIVEN no previous records
+  fp::trace::clear();
+
+  // WHEN we chain three stages where the last one fails
+  const auto result = fp::make_result(4.0) | divide_4_by | divide_4_by |
+                      [](double) -> fp::Result<double> {
+    return tl::make_unexpected(fp::Unknown());
+  };
+
+  // THEN we expect a record for each stage with the last one not ok
+  ASSERT_FALSE(result);
+  const auto records = fp::trace::records();
+  std::vector<fp::trace::Record> all;
+  for (auto const& [tid, thread_records] : records) {
+    all.insert(all.end(), thread_records.begin(), thread_records.end());
+  }
+  ASSERT_EQ(all.size(), 3);
+  EXPECT_TRUE(all[0].ok);
+  EXPECT_TRUE(all[1].ok);
+  EXPECT_FALSE(all[2].ok);
+  EXPECT_LE(all[0].begin_ns, all[0].end_ns);
+  EXPECT_LE(all[0].end_ns, all[1].begin_ns);
+}
+
+TEST(TraceTests, NamedStage) {
+  // GIVEN no previous records
+  fp::trace::clear();
+
+  // WHEN we compose a named stage and call it
+  const auto f = fp::mcompose(fp::trace::named("first", divide_4_by),
+                              fp::trace::named("second", divide_4_by));
+  const auto result = f(2.0);
+
+  // THEN we expect the names in the chrome trace
+  ASSERT_TRUE(result);
+  const auto json = fp::trace::chrome_trace_json();
+  EXPECT_NE(json.find("\"name\":\"first\""), std::string::npos) << json;
+  EXPECT_NE(json.find("\"name\":\"second\""), std::string::npos) << json;
+}
+
+TEST(TraceTests, TypeNameIsDemangled) {
+  // GIVEN a record with the mangled type name of a stage
+  const auto record = fp::trace::Record{typeid(std::string).name(), true};
+
+  // WHEN we get its name
+  // THEN we expect it to be demangled
+  EXPECT_NE(fp::trace::name(record).find("std::"), std::string::npos);
+}
+
+TEST(TraceTests, RecordsPerThread) {
+  // GIVEN no previous records
+  fp::trace::clear();
+
+  // WHEN we run a pipeline on several threads
+  auto threads = std::vector<std::thread>{};
+  for (int i = 0; i < 4; ++i) {
+    threads.emplace_back([] {
+      for (int j = 0; j < 10; ++j) {
+        (void)(fp::make_result(1.0) | divide_4_by);
+      }
+    });
+  }
+  for (auto& thread : threads) thread.join();
+
+  // THEN we expect all the records to be kept
+  EXPECT_EQ(count_records(), 40);
+}
+
+TEST(TraceTests, ReusesBuffersOfExitedThreads) {
+  // GIVEN the buffers of the threads that traced so far
+  auto const trace = [] { (void)(fp::make_result(1.0) | divide_4_by); };
+  std::thread{trace}.join();
+  auto const before = fp::trace::Registry::instance().buffers().size();
+
+  // WHEN many short lived threads trace one after another
+  for (int i = 0; i < 50; ++i) std::thread{trace}.join();
+
+  // THEN their buffers are reused instead of new ones being kept
+  EXPECT_EQ(fp::trace::Registry::instance().buffers().size(), before);
+}
+
+TEST(TraceTests, RingBufferKeepsNewest) {
+  // GIVEN a ring buffer
+  auto buffer = fp::trace::RingBuffer{0};
+
+  // WHEN we push more records than it can hold
+  for (int64_t i = 0; i < FP_TRACE_CAPACITY + 10; ++i) {
+    buffer.push(fp::trace::Record{"stage", false, true, i, i});
+  }
+
+  // THEN we expect only the newest records
+  const auto records = buffer.snapshot();
+  ASSERT_EQ(records.size(), FP_TRACE_CAPACITY);
+  EXPECT_EQ(records.front().begin_ns, 10);
+  EXPECT_EQ(records.back().begin_ns, FP_TRACE_CAPACITY + 9);
+}
+
+TEST(TraceTests, WriteChromeTraceBadPath) {
+  // GIVEN a path that cannot be written
+  const auto path = "/nonexistent/trace.json";
+
+  // WHEN we write the trace to it
+  const auto result = fp::trace::write_chrome_trace(path);
+
+  // THEN we expect an error
+  EXPECT_FALSE(result);
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
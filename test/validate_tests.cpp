@@ -27,7 +27,9 @@
 // POSSIBILITY OF SUCH DAMAGE.
 
 #include <cmath>
+#include <cstdint>
 #include <functional>
+#include <limits>
 #include <optional>
 
 #include "fp/all.hpp"
@@ -88,6 +90,78 @@ TEST(ValidateTests, ValidateRangeStepInt) {
   EXPECT_FALSE(result);
 }
 
+TEST(ValidateTests, ValidateRangeStepIntTrue) {
+  // GIVEN validation of the range [-7, inf, 3]
+  const auto test = fp::validate_range<int>{.from = -7, .step = 3};
+
+  // WHEN we we validate the value 14
+  const auto result = test(14, "test");
+
+  // THEN we expect it be true
+  EXPECT_TRUE(result) << fmt::format("{}", result);
+}
+
+TEST(ValidateTests, ValidateRangeStepNegativeInt) {
+  // GIVEN validation of the range [-inf, inf, -5]
+  const auto test = fp::validate_range<int>{.step = -5};
+
+  // WHEN we we validate the value max (2147483647, an offset of 2^32 - 1)
+  const auto result = test(std::numeric_limits<int>::max(), "test");
+
+  // THEN we expect it be true without overflowing
+  EXPECT_TRUE(result) << fmt::format("{}", result);
+}
+
+TEST(ValidateTests, ValidateRangeStepInt64Exact) {
+  // GIVEN validation of the range [0, inf, 3] on 64 bit integers
+  const auto test = fp::validate_range<int64_t>{.from = 0, .step = 3};
+
+  // WHEN we we validate a value above 2^53 that is one past a step
+  const auto result = test(int64_t{3} * (int64_t{1} << 55) + 1, "test");
+
+  // THEN we expect it be false
+  EXPECT_FALSE(result) << fmt::format("{}", result);
+}
+
+TEST(ValidateTests, ValidateRangeStepUnsigned) {
+  // GIVEN validation of the range [10, inf, 4] on unsigned integers
+  const auto test = fp::validate_range<uint64_t>{.from = 10, .step = 4};
+
+  // WHEN we we validate the values 18 and 19
+  // THEN we expect 18 to be true and 19 to be false
+  EXPECT_TRUE(test(18, "test"));
+  EXPECT_FALSE(test(19, "test"));
+}
+
+TEST(ValidateTests, ValidateRangeStepSmallSigned) {
+  // GIVEN validation of the range [-100, 100, 3] on 8 and 16 bit integers
+  const auto test8 = fp::validate_range<int8_t>{.from = -100, .to = 100,
+                                                .step = 3};
+  const auto test16 = fp::validate_range<int16_t>{.from = -100, .to = 100,
+                                                  .step = -3};
+
+  // WHEN we we validate the values -97 and -96
+  // THEN we expect -97 to be true and -96 to be false
+  EXPECT_TRUE(test8(-97, "test"));
+  EXPECT_FALSE(test8(-96, "test"));
+  EXPECT_TRUE(test16(-97, "test"));
+  EXPECT_FALSE(test16(-96, "test"));
+}
+
+TEST(ValidateTests, ValidateRangeStepSmallUnsigned) {
+  // GIVEN validation of the range [10, max, 4] on 8 and 16 bit unsigned
+  // integers
+  const auto test8 = fp::validate_range<uint8_t>{.from = 10, .step = 4};
+  const auto test16 = fp::validate_range<uint16_t>{.from = 10, .step = 4};
+
+  // WHEN we we validate the values 254 and 255
+  // THEN we expect 254 to be true and 255 to be false
+  EXPECT_TRUE(test8(254, "test"));
+  EXPECT_FALSE(test8(255, "test"));
+  EXPECT_TRUE(test16(254, "test"));
+  EXPECT_FALSE(test16(255, "test"));
+}
+
 TEST(ValidateTests, ValidateRangeToDoubleTrue) {
   // GIVEN validation of the range [-inf, inf, 2]
   const auto test = fp::validate_range<double>{.step = 2};
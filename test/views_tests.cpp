@@ -0,0 +1,162 @@
+// Copyright 2022 PickNik Inc
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//    * Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//    * Redistributions in binary form must reproduce the above copyright
+//      notice, this list of conditions and the following disclaimer in the
+//      documentation and/or other materials provided with the distribution.
+//
+//    * Neither the name of the PickNik Inc nor the names of its
+//      contributors may be used to endorse or promote products derived from
+//      this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "fp/all.hpp"
+#include "gtest/gtest.h"
+
+namespace {
+fp::Result<double> reciprocal(double x) {
+  if (x == 0.0) {
+    return tl::make_unexpected(fp::InvalidArgument("divide by 0"));
+  }
+  return 1.0 / x;
+}
+
+fp::Result<std::unique_ptr<int>> make_unique_int(int x) {
+  if (x < 0) {
+    return tl::make_unexpected(fp::OutOfRange(std::to_string(x)));
+  }
+  return std::make_unique<int>(x);
+}
+}  // namespace
+
+TEST(ViewsTests, AndThen) {
+  // GIVEN a vector of results
+  const auto results = std::vector<fp::Result<double>>{
+      fp::make_result(2.0), fp::make_result(0.0),
+      tl::make_unexpected(fp::NotFound())};
+
+  // WHEN we apply and_then
+  const auto reciprocals = results | fp::views::and_then(reciprocal) |
+                           ranges::to<std::vector>();
+
+  // THEN we expect the function applied to the values and errors passed on
+  ASSERT_EQ(reciprocals.size(), 3U);
+  EXPECT_EQ(reciprocals.at(0), fp::make_result(0.5));
+  EXPECT_EQ(reciprocals.at(1).error().code, fp::ErrorCode::INVALID_ARGUMENT);
+  EXPECT_EQ(reciprocals.at(2).error().code, fp::ErrorCode::NOT_FOUND);
+}
+
+TEST(ViewsTests, Map) {
+  // GIVEN a vector of results
+  const auto results = std::vector<fp::Result<int>>{
+      fp::make_result(2), tl::make_unexpected(fp::NotFound())};
+
+  // WHEN we apply map
+  const auto doubled = results |
+                       fp::views::map([](int x) { return x * 2; }) |
+                       ranges::to<std::vector>();
+
+  // THEN we expect the function applied to the values
+  ASSERT_EQ(doubled.size(), 2U);
+  EXPECT_EQ(doubled.at(0), fp::make_result(4));
+  EXPECT_FALSE(doubled.at(1));
+}
+
+TEST(ViewsTests, ValuesAndErrors) {
+  // GIVEN a vector of results
+  const auto results = std::vector<fp::Result<int>>{
+      fp::make_result(1), tl::make_unexpected(fp::NotFound("a")),
+      fp::make_result(3), tl::make_unexpected(fp::Timeout("b"))};
+
+  // WHEN we select the values and errors
+  const auto values = results | fp::views::values | ranges::to<std::vector>();
+  const auto errors = results | fp::views::errors | ranges::to<std::vector>();
+
+  // THEN we expect them in order
+  EXPECT_EQ(values, (std::vector<int>{1, 3}));
+  EXPECT_EQ(errors, (std::vector<fp::Error>{fp::NotFound("a"),
+                                            fp::Timeout("b")}));
+}
+
+TEST(ViewsTests, ValuesOfTransformCalledOnce) {
+  // GIVEN a transform that counts calls
+  const auto input = std::vector<int>{1, -2, 3};
+  auto calls = 0;
+  const auto counted = [&calls](int x) {
+    ++calls;
+    return make_unique_int(x);
+  };
+
+  // WHEN we select the values of the transformed range
+  auto values = input | ranges::views::transform(counted) | fp::views::values |
+                ranges::to<std::vector>();
+
+  // THEN we expect each element produced once and move-only values moved out
+  EXPECT_EQ(calls, 3);
+  ASSERT_EQ(values.size(), 2U);
+  EXPECT_EQ(*values.at(0), 1);
+  EXPECT_EQ(*values.at(1), 3);
+}
+
+TEST(ViewsTests, PartitionResults) {
+  // GIVEN a vector of results and preallocated output buffers
+  const auto results = std::vector<fp::Result<double>>{
+      fp::make_result(1.0), tl::make_unexpected(fp::NotFound()),
+      fp::make_result(2.0)};
+  auto values = std::vector<double>(results.size());
+  auto errors = std::vector<fp::Error>(results.size());
+
+  // WHEN we partition them
+  const auto [values_last, errors_last] =
+      fp::partition_results(results, values.begin(), errors.begin());
+
+  // THEN we expect the values and errors written in order
+  values.erase(values_last, values.end());
+  errors.erase(errors_last, errors.end());
+  EXPECT_EQ(values, (std::vector<double>{1.0, 2.0}));
+  EXPECT_EQ(errors, (std::vector<fp::Error>{fp::NotFound()}));
+}
+
+TEST(ViewsTests, PartitionResultsMoves) {
+  // GIVEN a range producing move-only values
+  const auto input = std::vector<int>{1, -2, 3};
+
+  // WHEN we partition it
+  auto values = std::vector<std::unique_ptr<int>>{};
+  auto errors = std::vector<fp::Error>{};
+  fp::partition_results(input | ranges::views::transform(make_unique_int),
+                        std::back_inserter(values),
+                        std::back_inserter(errors));
+
+  // THEN we expect the values moved out
+  ASSERT_EQ(values.size(), 2U);
+  EXPECT_EQ(*values.at(1), 3);
+  ASSERT_EQ(errors.size(), 1U);
+  EXPECT_EQ(errors.at(0).what, "-2");
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}